@@ -0,0 +1,78 @@
+#include "cache.hpp"
+
+ChunkCache::ChunkCache(void) : ChunkCache(CHUNK_CACHE_BUDGET) {}
+
+ChunkCache::ChunkCache(size_t budget)
+    : _codec(getChunkCodec(CHUNK_CACHE_CODEC)), _budget(budget) {
+  _scratch.resize(_codec->maxEncodedSize());
+}
+
+ChunkCache::~ChunkCache(void) {}
+
+void ChunkCache::put(glm::ivec2 pos, const Block* data,
+                     const BlockEdits& edits, bool edits_complete) {
+  erase(pos);
+  size_t size = _codec->encode(data, _scratch.data());
+  _lru.push_front(pos);
+  CachedChunk& entry = _entries[pos];
+  entry.encoded.assign(_scratch.begin(), _scratch.begin() + size);
+  entry.edits = edits;
+  entry.edits_complete = edits_complete;
+  entry.lru_it = _lru.begin();
+  // Map nodes are about the size of 4 pointers on top of their value
+  entry.bytes = sizeof(CachedChunk) + entry.encoded.size() +
+                entry.edits.size() *
+                    (sizeof(BlockEdits::value_type) + 4 * sizeof(void*));
+  _stats.bytes += entry.bytes;
+  _stats.chunks++;
+  evict();
+}
+
+bool ChunkCache::take(glm::ivec2 pos, Block* data, BlockEdits& edits,
+                      bool& edits_complete) {
+  auto entry_it = _entries.find(pos);
+  if (entry_it == _entries.end()) {
+    _stats.misses++;
+    return (false);
+  }
+  CachedChunk& entry = entry_it->second;
+  bool decoded = _codec->decode(entry.encoded.data(), entry.encoded.size(), data);
+  if (decoded) {
+    edits = std::move(entry.edits);
+    edits_complete = entry.edits_complete;
+  }
+  erase(pos);
+  // A corrupt entry is reloaded from disk like any miss
+  if (decoded) {
+    _stats.hits++;
+  } else {
+    _stats.misses++;
+  }
+  return (decoded);
+}
+
+bool ChunkCache::contains(glm::ivec2 pos) const {
+  return (_entries.find(pos) != _entries.end());
+}
+
+void ChunkCache::countMiss() { _stats.misses++; }
+
+void ChunkCache::erase(glm::ivec2 pos) {
+  auto entry_it = _entries.find(pos);
+  if (entry_it == _entries.end()) {
+    return;
+  }
+  _stats.bytes -= entry_it->second.bytes;
+  _stats.chunks--;
+  _lru.erase(entry_it->second.lru_it);
+  _entries.erase(entry_it);
+}
+
+void ChunkCache::evict() {
+  while (_stats.bytes > _budget && _lru.empty() == false) {
+    erase(_lru.back());
+    _stats.evictions++;
+  }
+}
+
+CacheStats ChunkCache::getStats() const { return (_stats); }
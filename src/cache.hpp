@@ -0,0 +1,57 @@
+#pragma once
+#define GLM_ENABLE_EXPERIMENTAL
+#include <glm/glm.hpp>
+#include <list>
+#include <unordered_map>
+#include <vector>
+#include "codec.hpp"
+#include "ft_vox.hpp"
+
+struct CachedChunk {
+  std::vector<unsigned char> encoded;
+  BlockEdits edits;
+  bool edits_complete;
+  size_t bytes;  // Counted against the budget
+  std::list<glm::ivec2>::iterator lru_it;
+};
+
+struct CacheStats {
+  size_t hits = 0;
+  size_t misses = 0;
+  size_t evictions = 0;
+  size_t bytes = 0;
+  size_t chunks = 0;
+};
+
+// Compressed copies of chunks that left render distance, so turning back
+// does not go through the disk. Entries are always in sync with the region
+// files (chunks are saved before being cached) and can be dropped anytime.
+// Least recently cached chunks are evicted once over budget.
+class ChunkCache {
+ public:
+  ChunkCache(void);
+  ChunkCache(size_t budget);
+  ~ChunkCache(void);
+
+  void put(glm::ivec2 pos, const Block* data, const BlockEdits& edits,
+           bool edits_complete);
+  // Inflates pos into data and removes it from the cache
+  bool take(glm::ivec2 pos, Block* data, BlockEdits& edits,
+            bool& edits_complete);
+  bool contains(glm::ivec2 pos) const;
+  void countMiss();  // For callers that checked contains() instead of take()
+  void erase(glm::ivec2 pos);
+  CacheStats getStats() const;
+
+ private:
+  ChunkCache(ChunkCache const& src);
+  ChunkCache& operator=(ChunkCache const& rhs);
+  void evict();
+
+  const ChunkCodec* _codec;
+  size_t _budget;
+  std::list<glm::ivec2> _lru;  // Front is the most recently cached
+  std::unordered_map<glm::ivec2, CachedChunk, ivec2Comparator> _entries;
+  std::vector<unsigned char> _scratch;
+  CacheStats _stats;
+};
@@ -17,18 +17,33 @@ enum Color {
   WHITE = 7
 };
 
+// Circular areas, radius in chunks
+inline bool in_radius(glm::ivec2 chunk_pos, glm::ivec2 center, int radius) {
+  glm::ivec2 offset = (chunk_pos - center) / CHUNK_SIZE;
+  return (static_cast<int64_t>(offset.x) * offset.x +
+              static_cast<int64_t>(offset.y) * offset.y <=
+          static_cast<int64_t>(radius) * radius);
+}
+
 Chunk::Chunk() : Chunk(glm::ivec3(0)) {}
 
 Chunk::Chunk(glm::ivec3 pos)
-    : aabb_center(0.0f), aabb_halfsize(0.0f), _pos(pos), generated(false) {
+    : aabb_center(0.0f),
+      aabb_halfsize(0.0f),
+      _pos(pos),
+      generated(false),
+      edits_complete(true),
+      unsaved(true),
+      job_ticket(0),
+      _state(ChunkState::Queued) {
   _renderAttrib.model = glm::translate(_pos);
-  for (int i = 0; i < MODEL_PER_CHUNK; i++) {
-    this->dirty[i] = true;
+  forceFullRemesh();
+  for (int i = 0; i < 9; i++) {
+    _neighbours[i] = nullptr;
   }
+  _neighbours[4] = this;
 }
 
-Chunk::Chunk(Chunk const& src) { *this = src; }
-
 Chunk::~Chunk(void) {
   for (auto& vao : _renderAttrib.vaos) {
     delete vao;
@@ -40,69 +55,56 @@ Material get_material_color(Color c) {
   return static_cast<Material>((int)block.material + static_cast<int>(c));
 }
 
-Chunk& Chunk::operator=(Chunk const& rhs) {
-  if (this != &rhs) {
-    this->_pos = rhs._pos;
-    std::memcpy(this->data, rhs.data, sizeof(this->data));
-    this->aabb_center = rhs.aabb_center;
-    this->aabb_halfsize = rhs.aabb_halfsize;
-    this->_renderAttrib.vaos = rhs._renderAttrib.vaos;
-    this->_renderAttrib.model = rhs._renderAttrib.model;
-    std::memcpy(this->dirty, rhs.dirty, sizeof(this->dirty));
-    this->_renderAttrib = rhs._renderAttrib;
-    this->_pos = rhs._pos;
-    this->generated = rhs.generated;
+void Chunk::uploadMesh(ChunkJobResult& result) {
+  if (_renderAttrib.vaos.size() != CHUNK_HEIGHT / MODEL_HEIGHT) {
+    _renderAttrib.vaos.resize(CHUNK_HEIGHT / MODEL_HEIGHT);
   }
-  return (*this);
+  for (int model_id = 0; model_id < MODEL_PER_CHUNK; model_id++) {
+    if (result.dirty[model_id] == false) {
+      continue;
+    }
+    if (_renderAttrib.vaos[model_id] == nullptr) {
+      _renderAttrib.vaos[model_id] = new VAO(result.vertices[model_id]);
+    } else {
+      _renderAttrib.vaos[model_id]->update(result.vertices[model_id]);
+    }
+  }
+  aabb_center = result.aabb_center;
+  aabb_halfsize = result.aabb_halfsize;
 }
 
-void Chunk::generate() {
-  generated = true;
-  generator::generate_chunk(this->data, this->biome_data, glm::vec3(_pos));
-  for (int i = 0; i < MODEL_PER_CHUNK; i++) {
-    this->dirty[i] = true;
+bool Chunk::setState(ChunkState state) {
+  static const bool allowed[7][7] = {
+      // Queued, Loading, Generated, Meshing, MeshReady, Uploaded, Unloading
+      {false, true, true, false, false, false, true},    // Queued
+      {false, false, true, false, false, false, true},   // Loading
+      {false, false, false, true, false, false, true},   // Generated
+      {false, false, false, false, true, false, true},   // Meshing
+      {false, false, false, false, false, true, true},   // MeshReady
+      {false, false, true, false, false, false, true},   // Uploaded
+      {false, false, false, false, false, false, false}  // Unloading
+  };
+  if (allowed[static_cast<int>(_state)][static_cast<int>(state)] == false) {
+    std::cerr << "chunk " << _pos.x << "," << _pos.z
+              << ": invalid state transition " << static_cast<int>(_state)
+              << " -> " << static_cast<int>(state) << std::endl;
+    return (false);
   }
+  _state = state;
+  return (true);
 }
 
-void Chunk::mesh() {
-  if (is_dirty()) {
-    if (_renderAttrib.vaos.size() != CHUNK_HEIGHT / MODEL_HEIGHT) {
-      _renderAttrib.vaos.resize(CHUNK_HEIGHT / MODEL_HEIGHT);
-    }
-    mesher::greedy(this, _renderAttrib);
-    mesher::get_aabb(data, aabb_center, aabb_halfsize, _pos);
-  }
-};
+ChunkState Chunk::getState() const { return (_state); }
 
 const RenderAttrib& Chunk::getRenderAttrib() { return (this->_renderAttrib); }
 
-enum BlockSide get_face(std::string last_step, glm::ivec3 sign) {
-  if (last_step == "x") {
-    if (sign.x == -1) {
-      return BlockSide::Left;
-    }
-    return BlockSide::Right;
-  } else if (last_step == "y") {
-    if (sign.y == 1) {
-      return BlockSide::Bottom;
-    }
-    return BlockSide::Up;
-  } else {
-    if (sign.z == 1) {
-      return BlockSide::Back;
-    }
-    return BlockSide::Front;
-  }
-}
-
 inline Block Chunk::get_block(glm::ivec3 index) {
   if (index.x < 0 || index.x >= CHUNK_SIZE || index.y < 0 || index.y >= 256 ||
-      index.z < 0 || index.z >= CHUNK_SIZE) {
+      index.z < 0 || index.z >= CHUNK_SIZE || this->data.empty()) {
     Block block = {};
     return (block);
   }
-  return (this->data[index.y * CHUNK_SIZE * CHUNK_SIZE + index.x * CHUNK_SIZE +
-                     index.z]);
+  return (this->data.get(BlockLayout::index(index)));
 }
 
 glm::mat4 Chunk::get_model_matrix() { return (this->_renderAttrib.model); }
@@ -121,13 +123,42 @@ inline void Chunk::set_block(Block block, glm::ivec3 index) {
       index.z < 0 || index.z >= CHUNK_SIZE) {
     return;
   }
-  this->data[index.y * CHUNK_SIZE * CHUNK_SIZE + index.x * CHUNK_SIZE +
-             index.z] = block;
+  // Not generated yet: the edit is replayed once it is
+  if (this->data.empty() == false) {
+    this->data.set(BlockLayout::index(index), block);
+  }
+  this->edits[static_cast<uint16_t>(FileLayout::index(index))] =
+      block.material;
+  this->unsaved = true;
   this->dirty[index.y / MODEL_HEIGHT] = true;
 }
 
 glm::ivec3 Chunk::get_pos() { return (_pos); }
 
+Chunk* Chunk::getNeighbour(int dx, int dz) {
+  return (_neighbours[(dx + 1) * 3 + dz + 1]);
+}
+
+Chunk* Chunk::getNeighbourFor(glm::ivec3& index) {
+  int dx = index.x >> 4;
+  int dz = index.z >> 4;
+  if (dx < -1 || dx > 1 || dz < -1 || dz > 1) {
+    return (nullptr);
+  }
+  index.x -= dx * CHUNK_SIZE;
+  index.z -= dz * CHUNK_SIZE;
+  return (_neighbours[(dx + 1) * 3 + dz + 1]);
+}
+
+Block Chunk::getBlockAcross(glm::ivec3 index) {
+  Chunk* chunk = getNeighbourFor(index);
+  if (chunk == nullptr) {
+    Block block = {};
+    return (block);
+  }
+  return (chunk->get_block(index));
+}
+
 bool Chunk::is_dirty() {
   for (int i = 0; i < MODEL_PER_CHUNK; i++) {
     if (dirty[i] == true) {
@@ -150,13 +181,27 @@ void ChunkManager::add_block(glm::ivec3 index) {
 void ChunkManager::point_exploding(glm::ivec3 index, float intensity) {
   float random;
   srand(time(nullptr));
+  glm::ivec3 origin((index.x >> 4) * CHUNK_SIZE, 0,
+                    (index.z >> 4) * CHUNK_SIZE);
+  Chunk* center = _chunks.find(glm::ivec2(origin.x, origin.z));
   for (int x = index.x - intensity; x < index.x + intensity; x++) {
-    for (int y = index.y - intensity; y < index.y + intensity; y++) {
-      for (int z = index.z - intensity; z < index.z + intensity; z++) {
+    for (int z = index.z - intensity; z < index.z + intensity; z++) {
+      // Column chunk through the neighbour links, the map past them
+      glm::ivec3 local = glm::ivec3(x, 0, z) - origin;
+      Chunk* chunk = center != nullptr ? center->getNeighbourFor(local)
+                                       : nullptr;
+      if (chunk == nullptr) {
+        chunk = _chunks.find(
+            glm::ivec2((x >> 4) * CHUNK_SIZE, (z >> 4) * CHUNK_SIZE));
+      }
+      if (chunk == nullptr) {
+        continue;
+      }
+      for (int y = index.y - intensity; y < index.y + intensity; y++) {
         if (glm::distance(glm::vec3(x, y, z), glm::vec3(index)) < intensity)
           if (rand() / static_cast<float>(RAND_MAX) * 0.3 + 0.7 >
               glm::distance(glm::vec3(x, y, z), glm::vec3(index)) / intensity) {
-            set_block(Block(Material::Air), glm::ivec3(x, y, z));
+            set_block(*chunk, Block(Material::Air), glm::ivec3(x, y, z));
           }
       }
     }
@@ -167,7 +212,24 @@ void Chunk::setDirty(int model_id) { dirty[model_id] = true; }
 
 ChunkManager::ChunkManager(void) : ChunkManager(42) {}
 
-ChunkManager::ChunkManager(uint32_t seed) : _renderDistance(10), _seed(seed) {
+ChunkManager::ChunkManager(uint32_t seed)
+    : _renderDistance(10),
+      _load_distance(0),
+      _unload_count(0),
+      _quick_reloads(0),
+      _codec(CodecId::RLE),
+      _journal_size(0),
+      _seed(seed),
+      _prefetch(PrefetchPolicy::Predictive),
+      _player_pos(0.0f),
+      _player_velocity(0.0f),
+      _frames(0),
+      _missing_frames(0),
+      _missing_chunks(0),
+      _jobs_in_flight(0),
+      _job_ticket(0),
+      _generate_time(0.0f),
+      _mesh_time(0.0f) {
   generator::init(10000, _seed);
   if (io::exists("world") == false) {
     io::makedir("world");
@@ -175,23 +237,46 @@ ChunkManager::ChunkManager(uint32_t seed) : _renderDistance(10), _seed(seed) {
   if (io::exists("world/" + std::to_string(_seed)) == false) {
     io::makedir("world/" + std::to_string(_seed));
   }
+  _journal_filename = "world/" + std::to_string(_seed) + "/journal.log";
+  _journal_flush_time = std::chrono::steady_clock::now();
+  replayJournal();
 }
 
-ChunkManager::ChunkManager(ChunkManager const& src) { *this = src; }
+ChunkManager::ChunkManager(ChunkManager const& src)
+    : _load_distance(0),
+      _unload_count(0),
+      _quick_reloads(0),
+      _prefetch(PrefetchPolicy::Predictive),
+      _player_pos(0.0f),
+      _player_velocity(0.0f),
+      _frames(0),
+      _missing_frames(0),
+      _missing_chunks(0),
+      _jobs_in_flight(0),
+      _job_ticket(0),
+      _generate_time(0.0f),
+      _mesh_time(0.0f) {
+  *this = src;
+}
 
 ChunkManager::~ChunkManager(void) {
-  std::unordered_set<glm::ivec2, ivec2Comparator> regions;
-  auto chunk_it = _chunks.begin();
-  while (chunk_it != _chunks.end()) {
-    glm::ivec2 chunk_pos(chunk_it->first);
-    glm::ivec2 region_pos((chunk_pos.x >> 8) * (REGION_SIZE * CHUNK_SIZE),
-                          (chunk_pos.y >> 8) * (REGION_SIZE * CHUNK_SIZE));
-    regions.insert(region_pos);
-    chunk_it++;
+  flushJournal();
+  // One region at a time, saveChunks drops emptied regions from the index
+  std::vector<glm::ivec2> regions;
+  for (const auto& region : _regions) {
+    regions.push_back(region.first);
   }
   for (const auto& region_pos : regions) {
-    unloadRegion(region_pos);
+    const ResidentRegion& region = _regions.find(region_pos)->second;
+    std::vector<glm::ivec2> positions(region.chunks.begin(),
+                                      region.chunks.end());
+    saveChunks(positions, true);
   }
+  // Every edit is now in a region file
+  RegionRequest truncate;
+  truncate.type = RegionRequestType::JournalTruncate;
+  truncate.filename = _journal_filename;
+  _region_worker.push(std::move(truncate));
 }
 
 ChunkManager& ChunkManager::operator=(ChunkManager const& rhs) {
@@ -201,72 +286,202 @@ ChunkManager& ChunkManager::operator=(ChunkManager const& rhs) {
   return (*this);
 }
 
-inline unsigned int getNearestIdx(glm::vec2 position,
-                                  const std::deque<glm::ivec2>& positions) {
-  unsigned int nearest = 0;
-  float min_dist = 99999.0f;
-  for (unsigned int i = 0; i < positions.size(); i++) {
-    float dist = glm::distance(position, glm::vec2(positions[i]));
-    if (dist < min_dist) {
-      nearest = i;
-      min_dist = dist;
-    }
+void ChunkManager::update(const glm::vec3& player_pos,
+                          const glm::vec3& view_dir, float delta_time) {
+  _scheduler.beginFrame(delta_time);
+  if (_frames > 0 && delta_time > 0.0f) {
+    glm::vec3 velocity = (player_pos - _player_pos) / delta_time;
+    _player_velocity += (velocity - _player_velocity) * 0.1f;
   }
-  return (nearest);
+  _player_pos = player_pos;
+  _frames++;
+  glm::ivec2 player_chunk_pos =
+      glm::ivec2((static_cast<int>(player_pos.x) >> 4) * CHUNK_SIZE,
+                 (static_cast<int>(player_pos.z) >> 4) * CHUNK_SIZE);
+  // Queues are only reordered when their centre changes chunk
+  glm::ivec2 focus = prefetch_focus(_prefetch, _player_pos, _player_velocity,
+                                    view_dir, _renderDistance);
+  to_generate.setCenter(focus);
+  to_mesh.setCenter(focus);
+  // Finished jobs first, then keep the workers busy
+  integrateJobs();
+  submitJobs();
+  uploadMeshes();
+  // Load and unload sets only change along with the player chunk
+  if (player_chunk_pos != _load_center || _renderDistance != _load_distance) {
+    updateLoadArea(player_chunk_pos);
+    findLeavingChunks(player_chunk_pos);
+  }
+  unloadLeavingChunks();
+  // Request chunks within renderDistance
+  loadChunks();
+  // Integrate one batch of chunks decoded by the I/O thread
+  RegionResult region;
+  if (_region_worker.poll(region)) {
+    loadRegion(region);
+  }
+  updateJournal();
+  _scheduler.endFrame();
 }
 
-void ChunkManager::update(const glm::vec3& player_pos) {
-  if (to_update.size() > 0) {
-    // unsigned int nearest_idx =
-    //   getNearestIdx(glm::vec2(player_pos.x, player_pos.z), to_update);
-    auto nearest_chunk_it = _chunks.find(to_update.front());
-    // auto nearest_chunk_it = _chunks.find(to_update[nearest_idx]);
-    if (nearest_chunk_it != _chunks.end()) {
-      nearest_chunk_it->second.mesh();
-      to_mesh.push_back(nearest_chunk_it->first);
+void ChunkManager::submitJobs() {
+  // Only a few jobs ahead of the workers, the queues keep the ordering
+  size_t max_jobs = _jobs.getThreadCount() * JOBS_PER_THREAD;
+  bool submitted = true;
+  while (submitted && _jobs_in_flight < max_jobs) {
+    submitted = false;
+    if (to_update.size() > 0) {
+      Chunk* chunk = _chunks.find(to_update.front());
+      if (chunk != nullptr && chunk->getState() == ChunkState::Generated) {
+        submitMesh(*chunk);
+      }
+      to_update.pop_front();
+      submitted = true;
     }
-    to_update.pop_front();
-    // to_update.erase(to_update.begin() + nearest_idx);
-  }
-  // Find nearest chunk and gen it
-  if (to_generate.size() > 0) {
-    unsigned int nearest_idx =
-        getNearestIdx(glm::vec2(player_pos.x, player_pos.z), to_generate);
-    auto nearest_chunk_it = _chunks.find(to_generate[nearest_idx]);
-    if (nearest_chunk_it != _chunks.end()) {
-      nearest_chunk_it->second.generate();
-      to_mesh.push_back(nearest_chunk_it->first);
+    // Find nearest chunk and mesh it
+    glm::ivec2 nearest_pos;
+    if (to_mesh.pop(nearest_pos)) {
+      Chunk* chunk = _chunks.find(nearest_pos);
+      if (chunk != nullptr && chunk->getState() == ChunkState::Generated) {
+        submitMesh(*chunk);
+      }
+      submitted = true;
     }
-    to_generate.erase(to_generate.begin() + nearest_idx);
-  }
-  // Find nearest chunk and mesh it
-  if (to_mesh.size() > 0) {
-    unsigned int nearest_idx =
-        getNearestIdx(glm::vec2(player_pos.x, player_pos.z), to_mesh);
-    auto nearest_chunk_it = _chunks.find(to_mesh[nearest_idx]);
-    if (nearest_chunk_it != _chunks.end()) {
-      nearest_chunk_it->second.mesh();
+    // Find nearest chunk and gen it
+    if (to_generate.pop(nearest_pos)) {
+      Chunk* chunk = _chunks.find(nearest_pos);
+      if (chunk != nullptr && chunk->getState() == ChunkState::Queued) {
+        submitGenerate(*chunk);
+      }
+      submitted = true;
     }
-    to_mesh.erase(to_mesh.begin() + nearest_idx);
   }
-  // Add regions within renderDistance
-  glm::ivec2 player_chunk_pos =
-      glm::ivec2((static_cast<int>(player_pos.x) >> 4) * CHUNK_SIZE,
-                 (static_cast<int>(player_pos.z) >> 4) * CHUNK_SIZE);
-  for (int x = -this->_renderDistance; x <= this->_renderDistance; x++) {
-    for (int z = -this->_renderDistance; z <= this->_renderDistance; z++) {
-      glm::ivec2 chunk_pos(player_chunk_pos.x + (x * CHUNK_SIZE),
-                           player_chunk_pos.y + (z * CHUNK_SIZE));
-      glm::ivec2 region_pos((chunk_pos.x >> 8) * (REGION_SIZE * CHUNK_SIZE),
-                            (chunk_pos.y >> 8) * (REGION_SIZE * CHUNK_SIZE));
-      addRegionToQueue(region_pos);
+}
+
+void ChunkManager::submitGenerate(Chunk& chunk) {
+  chunk.setState(ChunkState::Loading);
+  chunk.job_ticket = ++_job_ticket;
+  std::shared_ptr<ChunkJobResult> job(new ChunkJobResult);
+  job->type = ChunkJobType::Generate;
+  job->pos = glm::ivec2(chunk.get_pos().x, chunk.get_pos().z);
+  job->ticket = chunk.job_ticket;
+  _jobs_in_flight++;
+  _jobs.submit([this, job]() {
+    auto start = std::chrono::steady_clock::now();
+    job->data = getBlockPool().acquire();
+    std::fill(job->data.get(), job->data.get() + CHUNK_BLOCKS, Block());
+    job->biome.resize(CHUNK_SIZE * CHUNK_SIZE);
+    generator::generate_chunk(job->data.get(), job->biome.data(),
+                              glm::vec3(job->pos.x, 0, job->pos.y));
+    // Uniform sections are dropped here, off the render thread
+    job->sections.assign(job->data.get());
+    job->data.reset();
+    std::chrono::duration<float, std::milli> elapsed =
+        std::chrono::steady_clock::now() - start;
+    job->time = elapsed.count();
+    pushJobResult(*job);
+  });
+}
+
+void ChunkManager::submitMesh(Chunk& chunk) {
+  chunk.setState(ChunkState::Meshing);
+  chunk.job_ticket = ++_job_ticket;
+  std::shared_ptr<ChunkJobResult> job(new ChunkJobResult);
+  job->type = ChunkJobType::Mesh;
+  job->pos = glm::ivec2(chunk.get_pos().x, chunk.get_pos().z);
+  job->ticket = chunk.job_ticket;
+  // Edits made while the job runs dirty the chunk again
+  job->data = getBlockPool().acquire();
+  chunk.data.copyTo(job->data.get());
+  for (int i = 0; i < MODEL_PER_CHUNK; i++) {
+    job->dirty[i] = chunk.dirty[i];
+    chunk.dirty[i] = false;
+  }
+  // Bounds come from the block summary, no scan needed
+  glm::ivec3 chunk_pos = chunk.get_pos();
+  glm::ivec3 aabb_min(CHUNK_SIZE / 2, MODEL_HEIGHT / 2, CHUNK_SIZE / 2);
+  glm::ivec3 aabb_max = aabb_min;
+  chunk.data.getBounds(aabb_min, aabb_max);
+  job->aabb_center = (glm::vec3(aabb_min) + glm::vec3(aabb_max)) * 0.5f +
+                     glm::vec3(chunk_pos);
+  job->aabb_halfsize = (glm::vec3(aabb_max) - glm::vec3(aabb_min)) * 0.5f;
+  _jobs_in_flight++;
+  _jobs.submit([this, job]() {
+    auto start = std::chrono::steady_clock::now();
+    mesher::greedy(job->data.get(), job->dirty, job->vertices);
+    job->data.reset();
+    std::chrono::duration<float, std::milli> elapsed =
+        std::chrono::steady_clock::now() - start;
+    job->time = elapsed.count();
+    pushJobResult(*job);
+  });
+}
+
+// Worker side
+void ChunkManager::pushJobResult(ChunkJobResult& result) {
+  std::lock_guard<std::mutex> lock(_job_results_mutex);
+  _job_results.push_back(std::move(result));
+}
+
+void ChunkManager::integrateJobs() {
+  while (_scheduler.canRun(TaskType::Integrate)) {
+    ChunkJobResult result;
+    {
+      std::lock_guard<std::mutex> lock(_job_results_mutex);
+      if (_job_results.empty()) {
+        break;
+      }
+      result = std::move(_job_results.front());
+      _job_results.pop_front();
+    }
+    _jobs_in_flight--;
+    _scheduler.beginTask();
+    float& average =
+        result.type == ChunkJobType::Generate ? _generate_time : _mesh_time;
+    average += (result.time - average) * 0.1f;
+    // Unloaded, or reloaded since the job was submitted
+    Chunk* resident = _chunks.find(result.pos);
+    if (resident != nullptr && resident->job_ticket == result.ticket) {
+      Chunk& chunk = *resident;
+      if (result.type == ChunkJobType::Generate) {
+        chunk.data = std::move(result.sections);
+        std::copy(result.biome.begin(), result.biome.end(), chunk.biome_data);
+        // Edits made while generating included
+        for (const auto& edit : chunk.edits) {
+          chunk.data.set(edit_index(edit.first), Block(edit.second));
+        }
+        chunk.generated = true;
+        chunk.forceFullRemesh();
+        chunk.setState(ChunkState::Generated);
+        to_mesh.push(result.pos);
+      } else {
+        chunk.setState(ChunkState::MeshReady);
+        to_upload.push_back(std::move(result));
+      }
     }
+    _scheduler.endTask(TaskType::Integrate);
   }
-  // Unload regions
-  unloadRegions(player_chunk_pos);
-  if (to_unload.size() > 0) {
-    unloadRegion(to_unload.front());
-    to_unload.pop_front();
+}
+
+// GL calls, render thread only
+void ChunkManager::uploadMeshes() {
+  while (to_upload.size() > 0 && _scheduler.canRun(TaskType::Upload)) {
+    _scheduler.beginTask();
+    ChunkJobResult& result = to_upload.front();
+    Chunk* resident = _chunks.find(result.pos);
+    if (resident != nullptr && resident->job_ticket == result.ticket &&
+        resident->getState() == ChunkState::MeshReady) {
+      Chunk& chunk = *resident;
+      chunk.uploadMesh(result);
+      chunk.setState(ChunkState::Uploaded);
+      // Edited while meshing
+      if (chunk.is_dirty()) {
+        chunk.setState(ChunkState::Generated);
+        to_update.push_back(result.pos);
+      }
+    }
+    to_upload.pop_front();
+    _scheduler.endTask(TaskType::Upload);
   }
 }
 
@@ -328,12 +543,140 @@ void ChunkManager::Draw_earth(glm::vec3 pos, int size, glm::vec3 rot) {
   }
 }
 
-void ChunkManager::addRegionToQueue(glm::ivec2 region_pos) {
-  auto chunk = _chunks.find(region_pos);
-  if (chunk == _chunks.end()) {
-    // TODO : Defer this (1 max per frame)
-    loadRegion(region_pos);
+int ChunkManager::getSurfaceHeight(int x, int z) {
+  glm::ivec2 chunk_pos((x >> 4) * CHUNK_SIZE, (z >> 4) * CHUNK_SIZE);
+  Chunk* chunk = _chunks.find(chunk_pos);
+  if (chunk == nullptr || chunk->data.empty()) {
+    return (-1);
   }
+  return (chunk->data.getHeight(x - chunk_pos.x, z - chunk_pos.y));
+}
+
+void ChunkManager::updateLoadArea(glm::ivec2 player_chunk_pos) {
+  if (_renderDistance != _load_distance) {
+    // Spiral: rings of growing radius, each walked by angle
+    _load_offsets.clear();
+    int radius = _renderDistance;
+    for (int x = -radius; x <= radius; x++) {
+      for (int z = -radius; z <= radius; z++) {
+        if (x * x + z * z <= radius * radius) {
+          _load_offsets.push_back(glm::ivec2(x, z));
+        }
+      }
+    }
+    std::sort(_load_offsets.begin(), _load_offsets.end(),
+              [](const glm::ivec2& a, const glm::ivec2& b) {
+                int dist_a = a.x * a.x + a.y * a.y;
+                int dist_b = b.x * b.x + b.y * b.y;
+                if (dist_a != dist_b) {
+                  return (dist_a < dist_b);
+                }
+                return (std::atan2(a.y, a.x) < std::atan2(b.y, b.x));
+              });
+    // Resident chunks are skipped by loadChunks
+    _to_load.clear();
+    for (const auto& offset : _load_offsets) {
+      _to_load.push_back(player_chunk_pos + offset * CHUNK_SIZE);
+    }
+  } else {
+    // Still waiting and still in range, plus the chunks entering the area
+    std::vector<glm::ivec2> positions;
+    for (const auto& chunk_pos : _to_load) {
+      if (in_radius(chunk_pos, player_chunk_pos, _renderDistance)) {
+        positions.push_back(chunk_pos);
+      }
+    }
+    for (const auto& offset : _load_offsets) {
+      glm::ivec2 chunk_pos = player_chunk_pos + offset * CHUNK_SIZE;
+      if (!in_radius(chunk_pos, _load_center, _renderDistance)) {
+        positions.push_back(chunk_pos);
+      }
+    }
+    glm::ivec2 center = player_chunk_pos;
+    std::stable_sort(positions.begin(), positions.end(),
+                     [center](const glm::ivec2& a, const glm::ivec2& b) {
+                       glm::ivec2 dist_a = (a - center) / CHUNK_SIZE;
+                       glm::ivec2 dist_b = (b - center) / CHUNK_SIZE;
+                       return (dist_a.x * dist_a.x + dist_a.y * dist_a.y <
+                               dist_b.x * dist_b.x + dist_b.y * dist_b.y);
+                     });
+    _to_load.assign(positions.begin(), positions.end());
+  }
+  _load_center = player_chunk_pos;
+  _load_distance = _renderDistance;
+}
+
+void ChunkManager::loadChunks() {
+  // Missing chunks are batched, one request per region
+  std::unordered_map<glm::ivec2, RegionRequest, ivec2Comparator> requests;
+  std::deque<glm::ivec2> deferred;
+  int inflated = 0;
+  auto now = std::chrono::steady_clock::now();
+  while (_to_load.empty() == false) {
+    glm::ivec2 chunk_pos = _to_load.front();
+    _to_load.pop_front();
+    if (_chunks.find(chunk_pos) != nullptr ||
+        _pending_chunks.find(chunk_pos) != _pending_chunks.end()) {
+      continue;
+    }
+    // Cached chunks are inflated a few per frame, the rest wait
+    if (inflated >= CHUNK_CACHE_INFLATE && _cache.contains(chunk_pos)) {
+      deferred.push_back(chunk_pos);
+      continue;
+    }
+    auto unloaded = _unloaded.find(chunk_pos);
+    if (unloaded != _unloaded.end()) {
+      if (now - unloaded->second <
+          std::chrono::milliseconds(CHUNK_RELOAD_WINDOW)) {
+        _quick_reloads++;
+      }
+      _unloaded.erase(unloaded);
+    }
+    if (loadCachedChunk(chunk_pos)) {
+      inflated++;
+      continue;
+    }
+    glm::ivec2 region_pos((chunk_pos.x >> 8) * (REGION_SIZE * CHUNK_SIZE),
+                          (chunk_pos.y >> 8) * (REGION_SIZE * CHUNK_SIZE));
+    RegionRequest& request = requests[region_pos];
+    if (request.chunks.empty()) {
+      request.type = RegionRequestType::Load;
+      request.pos = region_pos;
+      request.filename = getRegionFilename(region_pos);
+    }
+    ChunkBuffer buffer;
+    buffer.pos = chunk_pos;
+    request.chunks.push_back(std::move(buffer));
+    _pending_chunks.insert(chunk_pos);
+  }
+  _to_load.swap(deferred);
+  for (auto& request : requests) {
+    _region_worker.push(std::move(request.second));
+  }
+}
+
+bool ChunkManager::loadCachedChunk(glm::ivec2 chunk_pos) {
+  // Most chunks are not cached, leave the store alone for those
+  if (_cache.contains(chunk_pos) == false) {
+    _cache.countMiss();
+    return (false);
+  }
+  bool inserted;
+  Chunk& chunk = *_chunks.insert(chunk_pos, inserted);
+  BlockBuffer blocks = getBlockPool().acquire();
+  if (_cache.take(chunk_pos, blocks.get(), chunk.edits,
+                  chunk.edits_complete) == false) {
+    _chunks.erase(chunk_pos);
+    return (false);
+  }
+  chunk.data.assign(blocks.get());
+  indexChunk(chunk_pos);
+  // Saved before being cached
+  chunk.generated = true;
+  chunk.unsaved = false;
+  chunk.setState(ChunkState::Generated);
+  this->to_mesh.push(chunk_pos);
+  return (true);
 }
 
 std::string ChunkManager::getRegionFilename(glm::ivec2 pos) {
@@ -343,142 +686,296 @@ std::string ChunkManager::getRegionFilename(glm::ivec2 pos) {
   return (filename);
 }
 
-void ChunkManager::loadRegion(glm::ivec2 region_pos) {
-  unsigned char chunk_rle[(CHUNK_SIZE * CHUNK_SIZE * CHUNK_HEIGHT) * 2] = {0};
-  unsigned char lookup[REGION_LOOKUPTABLE_SIZE] = {0};
-
-  std::string filename = getRegionFilename(region_pos);
-  if (io::exists(filename) == false) {
-    io::initRegionFile(filename);
-  }
-  unsigned int filesize = io::get_filesize(filename);
-  FILE* region = fopen(filename.c_str(), "rb+");
-  if (region != NULL) {
-    if (filesize < REGION_LOOKUPTABLE_SIZE) {
-      fclose(region);
-      return;
-    }
-    fread(lookup, REGION_LOOKUPTABLE_SIZE, 1, region);
-
-    int file_offset = REGION_LOOKUPTABLE_SIZE;
-    for (int y = 0; y < REGION_SIZE; y++) {
-      for (int x = 0; x < REGION_SIZE; x++) {
-        int lookup_offset = 3 * (x + y * REGION_SIZE);
-        unsigned int content_size =
-            ((unsigned int)(lookup[lookup_offset + 0]) << 16) |
-            ((unsigned int)(lookup[lookup_offset + 1]) << 8) |
-            ((unsigned int)(lookup[lookup_offset + 2]));
-
-        glm::ivec2 chunk_position = glm::ivec2(region_pos.x + (x * CHUNK_SIZE),
-                                               region_pos.y + (y * CHUNK_SIZE));
-        auto emplace_res = _chunks.emplace(
-            chunk_position, Chunk({chunk_position.x, 0, chunk_position.y}));
-        auto chunk_it = emplace_res.first;
-        if (content_size != 0) {
-          // Chunk already generated and saved on disk, just decode and mesh
-          // it back
-          if (filesize < file_offset + content_size) {
-            fclose(region);
-            return;
-          }
-          fseek(region, file_offset, SEEK_SET);
-          fread(chunk_rle, content_size, 1, region);
-          io::decodeRLE(chunk_rle, content_size, chunk_it->second.data,
-                        (CHUNK_SIZE * CHUNK_SIZE * CHUNK_HEIGHT));
-          chunk_it->second.generated = true;
-          this->to_mesh.push_back(chunk_it->first);
-        } else {
-          this->to_generate.push_back(chunk_it->first);
-        }
-        file_offset += content_size;
-      }
+void ChunkManager::loadRegion(RegionResult& region) {
+  for (auto& buffer : region.chunks) {
+    _pending_chunks.erase(buffer.pos);
+    // Left the area while being read, findLeavingChunks would not see it
+    if (!in_radius(buffer.pos, _load_center,
+                   _load_distance + CHUNK_UNLOAD_MARGIN)) {
+      continue;
+    }
+    bool inserted;
+    Chunk& chunk = *_chunks.insert(buffer.pos, inserted);
+    if (inserted == false) {
+      continue;
+    }
+    indexChunk(buffer.pos);
+    chunk.unsaved = !buffer.generated && buffer.edits.empty();
+    if (buffer.generated) {
+      // Chunk already generated and saved on disk, just mesh it back
+      chunk.data.assign(buffer.data.get());
+      buffer.data.reset();
+      chunk.generated = true;
+      chunk.edits_complete = false;
+      chunk.setState(ChunkState::Generated);
+      this->to_mesh.push(buffer.pos);
+    } else {
+      // Saved as deltas (or never saved), regenerate then replay edits
+      chunk.edits = std::move(buffer.edits);
+      this->to_generate.push(buffer.pos);
     }
-    fclose(region);
   }
 }
 
 void ChunkManager::eraseUnloadedChunk(glm::ivec2 pos) {
   // Remove chunk from queues
-  for (auto it = to_mesh.begin(); it != to_mesh.end(); it++) {
-    if (*it == pos) {
-      to_mesh.erase(it);
-      break;
-    }
+  to_mesh.erase(pos);
+  to_generate.erase(pos);
+}
+
+void ChunkManager::indexChunk(glm::ivec2 chunk_pos) {
+  glm::ivec2 region_pos((chunk_pos.x >> 8) * (REGION_SIZE * CHUNK_SIZE),
+                        (chunk_pos.y >> 8) * (REGION_SIZE * CHUNK_SIZE));
+  ResidentRegion& region = _regions[region_pos];
+  // Player came back before the region was emptied
+  region.state = RegionState::Resident;
+  region.chunks.insert(chunk_pos);
+}
+
+void ChunkManager::unindexChunk(glm::ivec2 chunk_pos) {
+  glm::ivec2 region_pos((chunk_pos.x >> 8) * (REGION_SIZE * CHUNK_SIZE),
+                        (chunk_pos.y >> 8) * (REGION_SIZE * CHUNK_SIZE));
+  auto region_it = _regions.find(region_pos);
+  if (region_it == _regions.end()) {
+    return;
   }
-  for (auto it = to_generate.begin(); it != to_generate.end(); it++) {
-    if (*it == pos) {
-      to_generate.erase(it);
-      break;
-    }
+  region_it->second.chunks.erase(chunk_pos);
+  if (region_it->second.chunks.empty()) {
+    _regions.erase(region_it);
   }
 }
 
-void ChunkManager::unloadRegion(glm::ivec2 region_pos) {
-  unsigned char chunk_rle[(CHUNK_SIZE * CHUNK_SIZE * CHUNK_HEIGHT) * 2] = {0};
-  unsigned char lookup[REGION_LOOKUPTABLE_SIZE] = {0};
-
-  std::string filename = getRegionFilename(region_pos);
-  if (io::exists(filename) == false) {
-    io::initRegionFile(filename);
-  }
-  FILE* region = fopen(filename.c_str(), "rb+");
-  if (region != NULL) {
-    fread(lookup, REGION_LOOKUPTABLE_SIZE, 1, region);
-
-    int file_offset = REGION_LOOKUPTABLE_SIZE;
-    for (int y = 0; y < REGION_SIZE; y++) {
-      for (int x = 0; x < REGION_SIZE; x++) {
-        int lookup_offset = 3 * (x + y * REGION_SIZE);
-        unsigned int content_size = 0;
-
-        glm::ivec2 chunk_position = glm::ivec2(region_pos.x + (x * CHUNK_SIZE),
-                                               region_pos.y + (y * CHUNK_SIZE));
-        auto chunk_it = _chunks.find(chunk_position);
-        if (chunk_it != _chunks.end()) {
-          if (chunk_it->second.generated) {
-            std::memset(chunk_rle, 0,
-                        (CHUNK_SIZE * CHUNK_SIZE * CHUNK_HEIGHT) * 2);
-            unsigned int len_rle = static_cast<unsigned int>(
-                io::encodeRLE(chunk_it->second.data, chunk_rle));
-            lookup[lookup_offset + 0] = (len_rle & 0xff0000) >> 16;
-            lookup[lookup_offset + 1] = (len_rle & 0xff00) >> 8;
-            lookup[lookup_offset + 2] = (len_rle & 0xff);
-            content_size = len_rle;
-            fseek(region, file_offset, SEEK_SET);
-            fwrite(chunk_rle, len_rle, 1, region);
-          }
-          eraseUnloadedChunk(chunk_it->first);
-          _chunks.erase(chunk_it);
-        }
-        file_offset += content_size;
+void ChunkManager::saveChunks(const std::vector<glm::ivec2>& positions,
+                              bool unload) {
+  std::unordered_map<glm::ivec2, RegionRequest, ivec2Comparator> requests;
+  for (const auto& chunk_pos : positions) {
+    Chunk* resident = _chunks.find(chunk_pos);
+    if (resident == nullptr) {
+      continue;
+    }
+    Chunk& chunk = *resident;
+    // Untouched since it was read back, the file is already up to date
+    if (chunk.unsaved) {
+      glm::ivec2 region_pos((chunk_pos.x >> 8) * (REGION_SIZE * CHUNK_SIZE),
+                            (chunk_pos.y >> 8) * (REGION_SIZE * CHUNK_SIZE));
+      RegionRequest& request = requests[region_pos];
+      if (request.chunks.empty()) {
+        request.type = RegionRequestType::Save;
+        request.pos = region_pos;
+        request.filename = getRegionFilename(region_pos);
+        request.codec = _codec;
+      }
+      ChunkBuffer buffer;
+      buffer.pos = chunk_pos;
+      buffer.generated = chunk.generated;
+      buffer.edits_complete = chunk.edits_complete;
+      if (unload) {
+        buffer.edits = std::move(chunk.edits);
+      } else {
+        buffer.edits = chunk.edits;
+      }
+      // Delta mode only needs the edits, unless they are unknown
+      if (buffer.generated &&
+          (_codec != CodecId::Delta || !buffer.edits_complete)) {
+        // Codecs work on flat buffers
+        buffer.data = getBlockPool().acquire();
+        chunk.data.copyTo(buffer.data.get());
       }
+      request.chunks.push_back(std::move(buffer));
+      chunk.unsaved = false;
     }
-    fseek(region, 0, SEEK_SET);
-    fwrite(lookup, REGION_LOOKUPTABLE_SIZE, 1, region);
-    fclose(region);
+    _journal_chunks.erase(chunk_pos);
+    if (unload) {
+      // Pending job results for it are dropped when they come back
+      chunk.setState(ChunkState::Unloading);
+      eraseUnloadedChunk(chunk_pos);
+      _chunks.erase(chunk_pos);
+      unindexChunk(chunk_pos);
+    }
+  }
+  // Encoding and writing happen on the I/O thread
+  for (auto& request : requests) {
+    _region_worker.push(std::move(request.second));
   }
 }
 
-void ChunkManager::unloadRegions(glm::ivec2 current_chunk_pos) {
-  std::unordered_set<glm::ivec2, ivec2Comparator> regions;
-  auto chunk_it = _chunks.begin();
-  while (chunk_it != _chunks.end()) {
-    glm::ivec2 chunk_pos(chunk_it->first);
+void ChunkManager::replayJournal() {
+  std::vector<io::JournalEntry> entries;
+  io::readJournal(_journal_filename, entries);
+  if (entries.empty()) {
+    return;
+  }
+  // Edits that never reached their region file (ie. crash), fold them in
+  // before any chunk gets loaded
+  std::unordered_map<glm::ivec2, BlockEdits, ivec2Comparator> chunk_edits;
+  for (const auto& entry : entries) {
+    glm::ivec2 chunk_pos((entry.pos.x >> 4) * CHUNK_SIZE,
+                         (entry.pos.z >> 4) * CHUNK_SIZE);
+    glm::ivec3 block = entry.pos - glm::ivec3(chunk_pos.x, 0, chunk_pos.y);
+    chunk_edits[chunk_pos][static_cast<uint16_t>(FileLayout::index(block))] =
+        entry.material;
+  }
+  std::unordered_map<glm::ivec2, RegionRequest, ivec2Comparator> patches;
+  for (auto& edits : chunk_edits) {
+    glm::ivec2 chunk_pos = edits.first;
     glm::ivec2 region_pos((chunk_pos.x >> 8) * (REGION_SIZE * CHUNK_SIZE),
                           (chunk_pos.y >> 8) * (REGION_SIZE * CHUNK_SIZE));
-    regions.insert(region_pos);
-    chunk_it++;
-  }
-  if (regions.size() > 0) {
-    for (auto region : regions) {
-      glm::ivec2 region_center = region + ((REGION_SIZE * CHUNK_SIZE) / 2);
-      float dist = fabs(glm::distance(glm::vec2(current_chunk_pos),
-                                      glm::vec2(region_center)));
-      if (round(dist) / CHUNK_SIZE >
-          static_cast<float>(this->_renderDistance + (REGION_SIZE + 1))) {
-        to_unload.push_back(region);
+    RegionRequest& patch = patches[region_pos];
+    if (patch.chunks.empty()) {
+      patch.type = RegionRequestType::Patch;
+      patch.pos = region_pos;
+      patch.filename = getRegionFilename(region_pos);
+      patch.codec = _codec;
+    }
+    ChunkBuffer buffer;
+    buffer.pos = chunk_pos;
+    buffer.edits = std::move(edits.second);
+    patch.chunks.push_back(std::move(buffer));
+  }
+  for (auto& patch : patches) {
+    _region_worker.push(std::move(patch.second));
+  }
+  RegionRequest truncate;
+  truncate.type = RegionRequestType::JournalTruncate;
+  truncate.filename = _journal_filename;
+  _region_worker.push(std::move(truncate));
+}
+
+void ChunkManager::updateJournal() {
+  auto now = std::chrono::steady_clock::now();
+  if (_journal_batch.size() >= JOURNAL_BATCH_SIZE ||
+      (_journal_batch.size() > 0 &&
+       now - _journal_flush_time >=
+           std::chrono::milliseconds(JOURNAL_FLUSH_INTERVAL))) {
+    flushJournal();
+  }
+  if (_journal_size >= JOURNAL_COMPACT_SIZE) {
+    compactJournal();
+  }
+}
+
+void ChunkManager::flushJournal() {
+  _journal_flush_time = std::chrono::steady_clock::now();
+  if (_journal_batch.empty()) {
+    return;
+  }
+  RegionRequest append;
+  append.type = RegionRequestType::JournalAppend;
+  append.filename = _journal_filename;
+  append.journal = std::move(_journal_batch);
+  _journal_size += append.journal.size();
+  _journal_batch.clear();
+  _region_worker.push(std::move(append));
+}
+
+void ChunkManager::compactJournal() {
+  flushJournal();
+  // Requests run in order: chunks are written before the journal is cut,
+  // and edits made from now on land in a new batch after the truncation
+  std::vector<glm::ivec2> positions(_journal_chunks.begin(),
+                                    _journal_chunks.end());
+  saveChunks(positions, false);
+  RegionRequest truncate;
+  truncate.type = RegionRequestType::JournalTruncate;
+  truncate.filename = _journal_filename;
+  _region_worker.push(std::move(truncate));
+  _journal_size = 0;
+}
+
+// Load and unload radii differ by CHUNK_UNLOAD_MARGIN, chunks past the
+// unload radius then wait CHUNK_UNLOAD_DELAY in _leaving: players going
+// back and forth along the border do not reload them
+void ChunkManager::findLeavingChunks(glm::ivec2 current_chunk_pos) {
+  int64_t keep = this->_renderDistance + CHUNK_UNLOAD_MARGIN;
+  std::vector<glm::ivec2> positions;
+  for (auto& region : _regions) {
+    if (region.second.state == RegionState::Unloading) {
+      continue;
+    }
+    // Chunk offsets, per axis, from the player chunk to the nearest and
+    // the farthest chunk of the region, compared in squared euclidean
+    // distance as in_radius() does: the unload area is a disc
+    glm::ivec2 region_min = (region.first - current_chunk_pos) / CHUNK_SIZE;
+    glm::ivec2 region_max = region_min + glm::ivec2(REGION_SIZE - 1);
+    glm::ivec2 near =
+        glm::max(glm::max(region_min, -region_max), glm::ivec2(0));
+    glm::ivec2 far = glm::max(glm::abs(region_min), glm::abs(region_max));
+    if (static_cast<int64_t>(far.x) * far.x +
+            static_cast<int64_t>(far.y) * far.y <=
+        keep * keep) {
+      continue;
+    }
+    if (static_cast<int64_t>(near.x) * near.x +
+            static_cast<int64_t>(near.y) * near.y >
+        keep * keep) {
+      region.second.state = RegionState::Unloading;
+      positions.insert(positions.end(), region.second.chunks.begin(),
+                       region.second.chunks.end());
+      continue;
+    }
+    // Region crossed by the unload border, only case checking its chunks
+    for (const auto& chunk_pos : region.second.chunks) {
+      if (!in_radius(chunk_pos, current_chunk_pos, keep)) {
+        positions.push_back(chunk_pos);
+      }
+    }
+  }
+  auto now = std::chrono::steady_clock::now();
+  for (const auto& chunk_pos : positions) {
+    _leaving.insert(std::make_pair(chunk_pos, now));
+  }
+  for (auto it = _unloaded.begin(); it != _unloaded.end();) {
+    if (now - it->second >= std::chrono::milliseconds(CHUNK_RELOAD_WINDOW)) {
+      it = _unloaded.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+void ChunkManager::unloadLeavingChunks() {
+  if (_leaving.empty()) {
+    return;
+  }
+  auto now = std::chrono::steady_clock::now();
+  std::vector<glm::ivec2> positions;
+  for (auto it = _leaving.begin(); it != _leaving.end();) {
+    glm::ivec2 chunk_pos = it->first;
+    if (_chunks.find(chunk_pos) == nullptr) {
+      it = _leaving.erase(it);
+    } else if (in_radius(chunk_pos, _load_center,
+                         _load_distance + CHUNK_UNLOAD_MARGIN)) {
+      // Came back in range, its region is checked again
+      glm::ivec2 region_pos(
+          (chunk_pos.x >> 8) * (REGION_SIZE * CHUNK_SIZE),
+          (chunk_pos.y >> 8) * (REGION_SIZE * CHUNK_SIZE));
+      auto region = _regions.find(region_pos);
+      if (region != _regions.end()) {
+        region->second.state = RegionState::Resident;
+      }
+      it = _leaving.erase(it);
+    } else if (now - it->second >=
+               std::chrono::milliseconds(CHUNK_UNLOAD_DELAY)) {
+      positions.push_back(chunk_pos);
+      it = _leaving.erase(it);
+    } else {
+      ++it;
+    }
+  }
+  if (positions.size() > 0) {
+    // Kept compressed in RAM, in case the player turns back
+    BlockBuffer blocks = getBlockPool().acquire();
+    for (const auto& chunk_pos : positions) {
+      const Chunk& chunk = *_chunks.find(chunk_pos);
+      if (chunk.generated) {
+        chunk.data.copyTo(blocks.get());
+        _cache.put(chunk_pos, blocks.get(), chunk.edits,
+                   chunk.edits_complete);
       }
+      _unloaded[chunk_pos] = now;
     }
+    _unload_count += positions.size();
+    saveChunks(positions, true);
   }
 }
 
@@ -492,142 +989,104 @@ void ChunkManager::setRenderAttributes(Renderer& renderer,
   frustrum_culling.updateViewPlanes(renderer.uniforms.view_proj);
 
   _debug_chunks_rendered = 0;
-  auto chunk_it = _chunks.begin();
-  while (chunk_it != _chunks.end()) {
-    glm::ivec3 c_pos = chunk_it->second.get_pos();
+  for (Chunk* chunk : _chunks.chunks()) {
+    glm::ivec3 c_pos = chunk->get_pos();
     float dist = glm::distance(glm::vec2(c_pos.x, c_pos.z), glm::vec2(pos));
     if (round(dist) / CHUNK_SIZE <
         static_cast<float>(this->_renderDistance + 1)) {
-      if (frustrum_culling.cull(chunk_it->second.aabb_center,
-                                chunk_it->second.aabb_halfsize)) {
-        renderer.addRenderAttrib(chunk_it->second.getRenderAttrib());
+      if (frustrum_culling.cull(chunk->aabb_center, chunk->aabb_halfsize)) {
+        renderer.addRenderAttrib(chunk->getRenderAttrib());
         _debug_chunks_rendered++;
       }
     }
-    chunk_it++;
   }
-}
-
-inline Block ChunkManager::get_block(glm::ivec3 index) {
-  glm::ivec2 chunk_pos =
-      glm::ivec2((index.x >> 4) * CHUNK_SIZE, (index.z >> 4) * CHUNK_SIZE);
-  auto chunk_it = _chunks.find(chunk_pos);
-  if (chunk_it != _chunks.end()) {
-    glm::ivec3 block_pos;
-    block_pos.x = index.x - chunk_pos.x;
-    block_pos.y = index.y;
-    block_pos.z = index.z - chunk_pos.y;
-    return (chunk_it->second.get_block(block_pos));
-  }
-  Block block = {};
-  return (block);
-}
-inline glm::mat4 ChunkManager::get_model_matrix(glm::ivec3 index) {
-  glm::ivec2 chunk_pos =
-      glm::ivec2((index.x >> 4) * CHUNK_SIZE, (index.z >> 4) * CHUNK_SIZE);
-  auto chunk_it = _chunks.find(chunk_pos);
-  if (chunk_it != _chunks.end()) {
-    glm::ivec3 block_pos;
-    block_pos.x = index.x - chunk_pos.x;
-    block_pos.y = index.y;
-    block_pos.z = index.z - chunk_pos.y;
-    return (chunk_it->second.get_model_matrix());
+  // Pop-in: columns of the load area in view without a mesh yet
+  _missing_chunks = 0;
+  for (const auto& offset : _load_offsets) {
+    glm::ivec2 chunk_pos = _load_center + offset * CHUNK_SIZE;
+    Chunk* chunk = _chunks.find(chunk_pos);
+    if (chunk != nullptr && chunk->getRenderAttrib().vaos.empty() == false) {
+      continue;
+    }
+    glm::vec3 half(CHUNK_SIZE / 2, CHUNK_HEIGHT / 2, CHUNK_SIZE / 2);
+    if (frustrum_culling.cull(glm::vec3(chunk_pos.x, 0, chunk_pos.y) + half,
+                              half)) {
+      _missing_chunks++;
+    }
+  }
+  if (_missing_chunks > 0) {
+    _missing_frames++;
   }
-  glm::mat4 m(1.0f);
-  return (m);
 }
 
 void ChunkManager::set_block(Block block, glm::ivec3 index) {
   glm::ivec2 chunk_pos =
       glm::ivec2((index.x >> 4) * CHUNK_SIZE, (index.z >> 4) * CHUNK_SIZE);
-  auto chunk_it = _chunks.find(chunk_pos);
-  if (chunk_it != _chunks.end()) {
-    glm::ivec3 block_pos;
-    block_pos.x = index.x - chunk_pos.x;
-    block_pos.y = index.y;
-    block_pos.z = index.z - chunk_pos.y;
-    chunk_it->second.forceFullRemesh();
-    chunk_it->second.set_block(block, block_pos);
-    bool found = false;
-    for (int i = 0; i < to_update.size(); i++) {
-      if (to_update[i] == chunk_it->first) {
-        found = true;
-        break;
-      }
-    }
-    if (found == false) {
-      to_update.push_back(chunk_it->first);
-    }
+  Chunk* chunk = _chunks.find(chunk_pos);
+  if (chunk != nullptr) {
+    set_block(*chunk, block, index);
   }
 }
 
-inline float intbound(float pos, float ds) {
-  return (ds > 0.0f ? ceil(pos) - pos : pos - floor(pos)) / fabs(ds);
+// index is in world coordinates and belongs to chunk
+void ChunkManager::set_block(Chunk& chunk, Block block, glm::ivec3 index) {
+  glm::ivec2 chunk_pos(chunk.get_pos().x, chunk.get_pos().z);
+  glm::ivec3 block_pos;
+  block_pos.x = index.x - chunk_pos.x;
+  block_pos.y = index.y;
+  block_pos.z = index.z - chunk_pos.y;
+  chunk.forceFullRemesh();
+  chunk.set_block(block, block_pos);
+  if (chunk.getState() == ChunkState::Uploaded) {
+    chunk.setState(ChunkState::Generated);
+  }
+  if (index.y >= 0 && index.y < CHUNK_HEIGHT) {
+    io::JournalEntry entry = {index, block.material};
+    _journal_batch.push_back(entry);
+    _journal_chunks.insert(chunk_pos);
+  }
+  bool found = false;
+  for (int i = 0; i < to_update.size(); i++) {
+    if (to_update[i] == chunk_pos) {
+      found = true;
+      break;
+    }
+  }
+  if (found == false) {
+    to_update.push_back(chunk_pos);
+  }
 }
 
 struct HitInfo ChunkManager::rayCast(glm::vec3 ray_dir, glm::vec3 ray_pos,
                                      float max_dist) {
-  // http://www.cse.chalmers.se/edu/year/2011/course/TDA361/grid.pdf
-  glm::ivec3 pos = glm::floor(ray_pos);
-  struct HitInfo info = {};
-  bool sign;
-  std::string last_step = "none";
-  glm::ivec3 step;
-  step.x = ray_dir.x < 0.0f ? -1 : 1;
-  step.y = ray_dir.y < 0.0f ? -1 : 1;
-  step.z = ray_dir.z < 0.0f ? -1 : 1;
-  glm::vec3 tMax;
-  glm::vec3 delta = glm::vec3(step) / ray_dir;
-  tMax.x = intbound(ray_pos.x, ray_dir.x);
-  tMax.y = intbound(ray_pos.y, ray_dir.y);
-  tMax.z = intbound(ray_pos.z, ray_dir.z);
-  Block block(Material::Air);
-  info.hit = 0;
-  while (1) {
-    if (pos.y > 255 || pos.y < 0) {
-      info.hit = false;
-      break;
-    }
-    if (block.material != Material::Air) {
-      info.hit = true;
-      break;
-    }
-    if (tMax.x < tMax.y) {
-      if (tMax.x < tMax.z) {
-        if (tMax.x > max_dist) break;
-        pos.x += step.x;
-        info.pos = pos;
-        last_step = "x";
-        tMax.x += delta.x;
-      } else {
-        if (tMax.z > max_dist) break;
-        pos.z += step.z;
-        info.pos = pos;
-        last_step = "z";
-        tMax.z += delta.z;
-      }
-    } else {
-      if (tMax.y < tMax.z) {
-        if (tMax.y > max_dist) break;
-        pos.y += step.y;
-        info.pos = pos;
-        tMax.y += delta.y;
-        last_step = "y";
-      } else {
-        if (tMax.z > max_dist) break;
-        last_step = "z";
-        pos.z += step.z;
-        info.pos = pos;
-        tMax.z += delta.z;
-      }
-    }
-    block = get_block(pos);
-  }
-  if (info.hit) {
-    info.side = get_face(last_step, step);
-    info.model = get_model_matrix(pos);
+  Ray ray = {ray_pos, ray_dir, max_dist};
+  // Followed through the neighbour links as the ray crosses chunks
+  Chunk* chunk = nullptr;
+  glm::ivec2 chunk_pos(0);
+  auto lookup = [&](glm::ivec2 pos) -> const ChunkSections* {
+    glm::ivec2 offset = (pos - chunk_pos) / CHUNK_SIZE;
+    chunk = chunk != nullptr ? chunk->getNeighbour(offset.x, offset.y)
+                             : _chunks.find(pos);
+    chunk_pos = pos;
+    return (chunk != nullptr ? &chunk->data : nullptr);
+  };
+  return (raycast::castRay(ray, lookup));
+}
+
+std::vector<HitInfo> ChunkManager::rayCastBatch(const std::vector<Ray>& rays) {
+  ChunkSnapshot snapshot;
+  getSnapshot(snapshot);
+  std::vector<HitInfo> hits;
+  raycast::castRays(snapshot, rays, hits, _jobs);
+  return (hits);
+}
+
+void ChunkManager::getSnapshot(ChunkSnapshot& snapshot) {
+  snapshot.clear();
+  for (Chunk* chunk : _chunks.chunks()) {
+    glm::ivec3 pos = chunk->get_pos();
+    snapshot.add(glm::ivec2(pos.x, pos.z), chunk->data);
   }
-  return info;
 }
 
 void ChunkManager::setRenderDistance(unsigned char rd) {
@@ -635,7 +1094,8 @@ void ChunkManager::setRenderDistance(unsigned char rd) {
 }
 
 void ChunkManager::increaseRenderDistance() {
-  if (this->_renderDistance + 1 <= 20) this->_renderDistance++;
+  if (this->_renderDistance + 1 <= RENDER_DISTANCE_MAX)
+    this->_renderDistance++;
 }
 
 void ChunkManager::decreaseRenderDistance() {
@@ -644,30 +1104,132 @@ void ChunkManager::decreaseRenderDistance() {
 
 void ChunkManager::setBlockType(struct Block type) { _current_block = type; }
 
+void ChunkManager::toggleCodec() {
+  _codec = static_cast<CodecId>((static_cast<int>(_codec) + 1) % CODEC_COUNT);
+}
+
+void ChunkManager::togglePrefetch() {
+  _prefetch = _prefetch == PrefetchPolicy::Distance ? PrefetchPolicy::Predictive
+                                                    : PrefetchPolicy::Distance;
+  // Counters compare policies, start over
+  _missing_frames = 0;
+  _frames = 1;
+}
+
 void ChunkManager::reloadMesh() {
   to_mesh.clear();
-  auto chunk_it = _chunks.begin();
-  while (chunk_it != _chunks.end()) {
-    chunk_it->second.forceFullRemesh();
-    to_mesh.push_back(chunk_it->first);
-    chunk_it++;
+  for (Chunk* chunk : _chunks.chunks()) {
+    chunk->forceFullRemesh();
+    // Meshing chunks come back dirty and get requeued after their upload
+    if (chunk->getState() == ChunkState::Uploaded) {
+      chunk->setState(ChunkState::Generated);
+    }
+    if (chunk->getState() == ChunkState::Generated) {
+      glm::ivec3 chunk_pos = chunk->get_pos();
+      to_mesh.push(glm::ivec2(chunk_pos.x, chunk_pos.z));
+    }
   }
 }
 
 void ChunkManager::print_chunkmanager_info(Renderer& renderer, float fheight,
                                            float fwidth) {
+  PoolStats pool = getBlockPool().getStats();
+  size_t block_bytes = 0;
+  for (const Chunk* chunk : _chunks.chunks()) {
+    block_bytes += chunk->data.getMemoryUsage();
+  }
   renderer.renderText(
       10.0f, fheight - 75.0f, 0.35f,
-      "chunks: " + std::to_string(_chunks.size()) +
-          ", rendered: " + std::to_string(_debug_chunks_rendered),
+      "chunks: " + std::to_string(_chunks.size()) + " (blocks " +
+          std::to_string(block_bytes / 1024) + " KB, " +
+          std::to_string(_chunks.size() > 0
+                             ? block_bytes / _chunks.size()
+                             : 0) +
+          " B/chunk; buffers " + std::to_string(pool.in_use) + "/" +
+          std::to_string(pool.buffers) + ", " +
+          std::to_string(pool.buffers * CHUNK_BLOCKS * sizeof(Block) /
+                         (1024 * 1024)) +
+          " MB) in " + std::to_string(_regions.size()) +
+          " regions (" + std::to_string(_chunks.getFallbackCount()) +
+          " off ring), rendered: " + std::to_string(_debug_chunks_rendered),
       glm::vec3(1.0f, 1.0f, 1.0f));
   renderer.renderText(10.0f, fheight - 100.0f, 0.35f,
                       "queue: mesh(" + std::to_string(to_mesh.size()) +
                           ") priority(" + std::to_string(to_update.size()) +
                           ") generate(" + std::to_string(to_generate.size()) +
-                          ") unload(" + std::to_string(to_unload.size()) + ")",
-                      glm::vec3(1.0f, 1.0f, 1.0f));
-  renderer.renderText(10.0f, fheight - 125.0f, 0.35f,
-                      "render distance: " + std::to_string(_renderDistance),
+                          ") load(" + std::to_string(_to_load.size()) +
+                          ") io(" + std::to_string(_region_worker.pending()) +
+                          ") journal(" + std::to_string(_journal_size) + ")",
                       glm::vec3(1.0f, 1.0f, 1.0f));
+  renderer.renderText(
+      10.0f, fheight - 125.0f, 0.35f,
+      "render distance: " + std::to_string(_renderDistance) + ", budget " +
+          std::to_string(static_cast<int>(_scheduler.getBudget() * 1000)) +
+          " us, tasks " + std::to_string(_scheduler.getTasksRun()) +
+          " (integrate " +
+          std::to_string(static_cast<int>(
+              _scheduler.getTaskCost(TaskType::Integrate) * 1000)) +
+          " us, upload " +
+          std::to_string(static_cast<int>(
+              _scheduler.getTaskCost(TaskType::Upload) * 1000)) +
+          " us)",
+      glm::vec3(1.0f, 1.0f, 1.0f));
+  renderer.renderText(
+      10.0f, fheight - 150.0f, 0.35f,
+      "jobs: " + std::to_string(_jobs.getThreadCount()) + " threads, " +
+          std::to_string(_jobs_in_flight) + " in flight, " +
+          std::to_string(_jobs.getStolenCount()) + " stolen, generate " +
+          std::to_string(static_cast<int>(_generate_time * 1000)) +
+          " us, mesh " + std::to_string(static_cast<int>(_mesh_time * 1000)) +
+          " us, upload(" + std::to_string(to_upload.size()) + ")",
+      glm::vec3(1.0f, 1.0f, 1.0f));
+  renderer.renderText(
+      10.0f, fheight - 200.0f, 0.35f,
+      "unload: " + std::to_string(_leaving.size()) + " leaving, " +
+          std::to_string(_unload_count) + " unloaded, " +
+          std::to_string(_quick_reloads) + " reloaded within " +
+          std::to_string(CHUNK_RELOAD_WINDOW / 1000) + " s",
+      glm::vec3(1.0f, 1.0f, 1.0f));
+  CacheStats cache = _cache.getStats();
+  renderer.renderText(
+      10.0f, fheight - 175.0f, 0.35f,
+      std::string("prefetch: ") +
+          (_prefetch == PrefetchPolicy::Predictive ? "predictive"
+                                                   : "distance") +
+          ", chunks missing in view " + std::to_string(_missing_chunks) +
+          ", frames " + std::to_string(_missing_frames) + "/" +
+          std::to_string(_frames),
+      glm::vec3(1.0f, 1.0f, 1.0f));
+  renderer.renderText(
+      10.0f, fheight - 225.0f, 0.35f,
+      "cache: " + std::to_string(cache.chunks) + " chunks, " +
+          std::to_string(cache.bytes / 1024) + "/" +
+          std::to_string(CHUNK_CACHE_BUDGET / 1024) + " KB, hit " +
+          std::to_string(cache.hits) + ", miss " +
+          std::to_string(cache.misses) + ", evicted " +
+          std::to_string(cache.evictions),
+      glm::vec3(1.0f, 1.0f, 1.0f));
+  for (int i = 0; i < CODEC_COUNT; i++) {
+    CodecId id = static_cast<CodecId>(i);
+    CodecStats stats = _region_worker.getCodecStats(id);
+    double raw_mb = sizeof(Block) * CHUNK_BLOCKS / (1024.0 * 1024.0);
+    size_t bytes_per_chunk =
+        stats.chunks_encoded ? stats.bytes_encoded / stats.chunks_encoded : 0;
+    int encode_speed = stats.encode_time > 0.0
+                           ? static_cast<int>(stats.chunks_encoded * raw_mb /
+                                              stats.encode_time)
+                           : 0;
+    int decode_speed = stats.decode_time > 0.0
+                           ? static_cast<int>(stats.chunks_decoded * raw_mb /
+                                              stats.decode_time)
+                           : 0;
+    renderer.renderText(
+        10.0f, fheight - 250.0f - i * 25.0f, 0.35f,
+        std::string(getCodecName(id)) +
+            (id == _codec ? " (write): " : ": ") +
+            std::to_string(bytes_per_chunk) + " B/chunk, encode " +
+            std::to_string(encode_speed) + " MB/s, decode " +
+            std::to_string(decode_speed) + " MB/s",
+        glm::vec3(1.0f, 1.0f, 1.0f));
+  }
 }
@@ -1,62 +1,126 @@
 #pragma once
 #define GLM_ENABLE_EXPERIMENTAL
+#include <chrono>
 #include <cmath>
 #include <glm/glm.hpp>
 #include <iostream>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <queue>
 #include <unordered_map>
 #include <unordered_set>
 #include <vector>
+#include "cache.hpp"
 #include "culling.hpp"
 #include "generator.hpp"
 #include "io.hpp"
+#include "jobs.hpp"
 #include "meshing.hpp"
+#include "pool.hpp"
+#include "prefetch.hpp"
+#include "queue.hpp"
+#include "raycast.hpp"
+#include "region.hpp"
 #include "renderer.hpp"
+#include "scheduler.hpp"
+#include "section.hpp"
+#include "store.hpp"
 #include "vao.hpp"
 
-struct ivec2Comparator {
-  size_t operator()(const glm::ivec2& k) const {
-    size_t h = std::hash<int>()(k.x) ^ (std::hash<int>()(k.y) << 1);
-    return (h);
-  }
+// Chunk lifecycle, see Chunk::setState for the allowed transitions:
+//   Queued     waiting for generation (or just read back)
+//   Loading    generation job running
+//   Generated  blocks ready, mesh missing or outdated
+//   Meshing    mesh job running on a copy of the blocks
+//   MeshReady  vertices waiting for the render thread
+//   Uploaded   VAOs up to date
+//   Unloading  being saved and dropped, final
+enum class ChunkState {
+  Queued,
+  Loading,
+  Generated,
+  Meshing,
+  MeshReady,
+  Uploaded,
+  Unloading
+};
+
+enum class ChunkJobType { Generate, Mesh };
+
+// Input and output of a worker job, owned by the job while it runs
+struct ChunkJobResult {
+  enum ChunkJobType type;
+  glm::ivec2 pos;
+  uint32_t ticket;  // Stale if it no longer matches Chunk::job_ticket
+  BlockBuffer data;  // Generate: scratch, Mesh: flat copy of the blocks
+  ChunkSections sections;  // Generate: output
+  std::vector<Biome> biome;
+  bool dirty[MODEL_PER_CHUNK];
+  std::vector<Vertex> vertices[MODEL_PER_CHUNK];  // Mesh: dirty sections
+  glm::vec3 aabb_center;
+  glm::vec3 aabb_halfsize;
+  float time;  // ms spent in the job
+};
+
+enum class RegionState {
+  Resident,  // At least one chunk loaded
+  Unloading  // Every chunk leaving, skipped until one comes back in range
+};
 
-  bool operator()(const glm::ivec2& a, const glm::ivec2& b) const {
-    return (a.x == b.x && a.y == b.y);
-  }
+// Chunks of _chunks grouped by region, kept in sync on load and unload
+struct ResidentRegion {
+  std::unordered_set<glm::ivec2, ivec2Comparator> chunks;
+  enum RegionState state = RegionState::Resident;
 };
 
+// Not copyable: owns its VAOs and its block buffer
 class Chunk {
  public:
   Chunk(glm::ivec3 pos);
-  Chunk(Chunk const& src);
   ~Chunk(void);
-  Chunk& operator=(Chunk const& rhs);
 
-  Block data[65536] = {};
+  ChunkSections data;  // Empty until generated or read back
   Biome biome_data[CHUNK_SIZE * CHUNK_SIZE] = {};
   glm::vec3 aabb_center;
   glm::vec3 aabb_halfsize;
-  bool dirty[CHUNK_HEIGHT / MODEL_HEIGHT] = {true};  // is Remesh needed ?
+  bool dirty[MODEL_PER_CHUNK];  // Per section, remesh needed
 
-  void mesh();
-  void generate();
+  void uploadMesh(ChunkJobResult& result);
+  bool setState(ChunkState state);
+  ChunkState getState() const;
+  bool is_dirty();
 
   inline Block get_block(glm::ivec3 index);
   inline Biome get_biome(glm::ivec3 index);
   inline void set_block(Block block, glm::ivec3 index);
+  // index may point up to one chunk away on x and z, index is then made
+  // local to the returned chunk. nullptr if that chunk is not resident.
+  Chunk* getNeighbourFor(glm::ivec3& index);
+  Block getBlockAcross(glm::ivec3 index);  // Air if not resident
+  Chunk* getNeighbour(int dx, int dz);  // dx, dz in [-1, 1]
   const RenderAttrib& getRenderAttrib();
   glm::ivec3 get_pos();
   bool generated;  // Needed on unload to avoid writing empty chunk to disk
+  BlockEdits edits;     // Replayed after generation, saved in delta mode
+  bool edits_complete;  // false if loaded from full blocks, edits unknown
+  bool unsaved;         // Differs from its region file
+  uint32_t job_ticket;  // Last job submitted for this chunk
   void forceFullRemesh();
   void setDirty(int model_id);
   glm::mat4 get_model_matrix();
 
  private:
+  friend class ChunkStore;  // Maintains _neighbours
   Chunk(void);
+  Chunk(Chunk const& src);
+  Chunk& operator=(Chunk const& rhs);
   RenderAttrib _renderAttrib;
+  // Resident chunks around this one, [(dx + 1) * 3 + dz + 1], centre is
+  // the chunk itself
+  Chunk* _neighbours[9];
   glm::ivec3 _pos;
-  bool is_dirty();
+  ChunkState _state;
 };
 
 class ChunkManager {
@@ -67,8 +131,14 @@ class ChunkManager {
   ~ChunkManager(void);
   ChunkManager& operator=(ChunkManager const& rhs);
 
-  void update(const glm::vec3& player_pos);
+  void update(const glm::vec3& player_pos, const glm::vec3& view_dir,
+              float delta_time);
   struct HitInfo rayCast(glm::vec3 ray_dir, glm::vec3 ray_pos, float max_dist);
+  // Every resident chunk, for raycast::castRays
+  void getSnapshot(ChunkSnapshot& snapshot);
+  // hits[i] is the hit of rays[i], cast on the workers and this thread
+  // against the chunks as they are now
+  std::vector<HitInfo> rayCastBatch(const std::vector<Ray>& rays);
   void setRenderAttributes(Renderer& renderer, glm::vec3 player_pos);
   void setRenderDistance(unsigned char renderDistance);
   void print_chunkmanager_info(Renderer& renderer, float window_height,
@@ -76,30 +146,90 @@ class ChunkManager {
   void increaseRenderDistance();
   void decreaseRenderDistance();
   void setBlockType(struct Block type);
+  void toggleCodec();
+  void togglePrefetch();
   void reloadMesh();
   void set_block(Block block, glm::ivec3 index);
+  void set_block(Chunk& chunk, Block block, glm::ivec3 index);
   void point_exploding(glm::ivec3 index, float intensity);
   void Draw_earth(glm::vec3 pos, int size, glm::vec3 rot);
   void add_block(glm::ivec3 index);
+  // Highest non-air y at a world column, -1 if all air or not generated
+  int getSurfaceHeight(int x, int z);
 
  private:
-  inline Block get_block(glm::ivec3 index);
-  glm::mat4 get_model_matrix(glm::ivec3 index);
-  void addRegionToQueue(glm::ivec2 chunk_pos);
-  void loadRegion(glm::ivec2 region_pos);
-  void unloadRegion(glm::ivec2 region_pos);
-  void unloadRegions(glm::ivec2 current_chunk_pos);
+  void updateLoadArea(glm::ivec2 player_chunk_pos);
+  void loadChunks();
+  void submitJobs();
+  void submitGenerate(Chunk& chunk);
+  void submitMesh(Chunk& chunk);
+  void pushJobResult(ChunkJobResult& result);
+  void integrateJobs();
+  void uploadMeshes();
+  bool loadCachedChunk(glm::ivec2 chunk_pos);
+  void loadRegion(RegionResult& region);
+  void saveChunks(const std::vector<glm::ivec2>& positions, bool unload);
+  void replayJournal();
+  void updateJournal();
+  void flushJournal();
+  void compactJournal();
+  void findLeavingChunks(glm::ivec2 current_chunk_pos);
+  void unloadLeavingChunks();
   std::string getRegionFilename(glm::ivec2 pos);
   void eraseUnloadedChunk(glm::ivec2 pos);
+  void indexChunk(glm::ivec2 chunk_pos);
+  void unindexChunk(glm::ivec2 chunk_pos);
   unsigned char _renderDistance;
-  std::unordered_map<glm::ivec2, Chunk, ivec2Comparator> _chunks;
+  // Load area as of the last update, recomputed when the player changes
+  // chunk or the render distance changes
+  glm::ivec2 _load_center;
+  unsigned char _load_distance;
+  std::vector<glm::ivec2> _load_offsets;  // Chunk offsets, nearest first
+  std::deque<glm::ivec2> _to_load;  // In range, not requested yet
+  ChunkStore _chunks;
+  std::unordered_map<glm::ivec2, ResidentRegion, ivec2Comparator> _regions;
   std::deque<glm::ivec2>
       to_update;  // User modified chunks, priority over everything else
-  std::deque<glm::ivec2> to_mesh;
-  std::deque<glm::ivec2> to_generate;
-  std::deque<glm::ivec2> to_unload;
+  ChunkQueue to_mesh;  // Nearest to the player first
+  ChunkQueue to_generate;
+  std::deque<ChunkJobResult> to_upload;  // Meshes waiting for the GL
+  std::unordered_set<glm::ivec2, ivec2Comparator>
+      _pending_chunks;  // Load requested, waiting for the I/O thread
+  // Past the unload radius, since
+  std::unordered_map<glm::ivec2, std::chrono::steady_clock::time_point,
+                     ivec2Comparator>
+      _leaving;
+  // Unloaded within CHUNK_RELOAD_WINDOW, when
+  std::unordered_map<glm::ivec2, std::chrono::steady_clock::time_point,
+                     ivec2Comparator>
+      _unloaded;
+  size_t _unload_count;
+  size_t _quick_reloads;  // Loaded back within CHUNK_RELOAD_WINDOW
+  RegionWorker _region_worker;
+  ChunkCache _cache;  // Chunks that recently left render distance
+  enum CodecId _codec;  // Used to write regions back
+  std::string _journal_filename;
+  std::vector<io::JournalEntry> _journal_batch;  // Not yet sent to disk
+  std::chrono::steady_clock::time_point _journal_flush_time;
+  size_t _journal_size;  // Edits appended since last compaction
+  std::unordered_set<glm::ivec2, ivec2Comparator>
+      _journal_chunks;  // Resident chunks edited since last compaction
+  FrameScheduler _scheduler;
   FrustrumCulling frustrum_culling;
   uint32_t _seed;
   size_t _debug_chunks_rendered;
+  enum PrefetchPolicy _prefetch;
+  glm::vec3 _player_pos;
+  glm::vec3 _player_velocity;  // Blocks per second, smoothed
+  size_t _frames;
+  size_t _missing_frames;  // Frames with a chunk in view not drawn yet
+  size_t _missing_chunks;  // During the last frame
   struct Block _current_block;
+  size_t _jobs_in_flight;  // Submitted, result not integrated yet
+  uint32_t _job_ticket;
+  float _generate_time;  // ms per job, smoothed
+  float _mesh_time;
+  std::mutex _job_results_mutex;
+  std::deque<ChunkJobResult> _job_results;  // Filled by the workers
+  JobSystem _jobs;  // Last: joined before the members its jobs use
 };
@@ -0,0 +1,276 @@
+#include "codec.hpp"
+
+#define PALETTE_RAW_MAX (MODEL_PER_CHUNK * (1 + 256 + SECTION_BLOCKS))
+
+size_t RLECodec::encode(const Block* data, unsigned char* dest) const {
+  return (io::encodeRLE(data, dest));
+}
+
+bool RLECodec::decode(const unsigned char* src, size_t size,
+                      Block* data) const {
+  io::decodeRLE(src, size, data, CHUNK_BLOCKS);
+  return (true);
+}
+
+inline unsigned int bits_for(size_t palette_size) {
+  unsigned int bits = 0;
+  while ((static_cast<size_t>(1) << bits) < palette_size) {
+    bits++;
+  }
+  return (bits);
+}
+
+size_t PaletteCodec::maxEncodedSize() const {
+  return (4 + lz::maxCompressedSize(PALETTE_RAW_MAX));
+}
+
+size_t PaletteCodec::encode(const Block* data, unsigned char* dest) const {
+  std::vector<unsigned char> raw;
+  raw.reserve(PALETTE_RAW_MAX);
+  for (int section_id = 0; section_id < MODEL_PER_CHUNK; section_id++) {
+    const Block* section = data + section_id * SECTION_BLOCKS;
+    int slots[256];
+    std::vector<unsigned char> palette;
+    std::memset(slots, -1, sizeof(slots));
+    for (int i = 0; i < SECTION_BLOCKS; i++) {
+      unsigned char material = static_cast<unsigned char>(section[i].material);
+      if (slots[material] == -1) {
+        slots[material] = static_cast<int>(palette.size());
+        palette.push_back(material);
+      }
+    }
+    raw.push_back(static_cast<unsigned char>(palette.size() - 1));
+    raw.insert(raw.end(), palette.begin(), palette.end());
+    unsigned int bits = bits_for(palette.size());
+    if (bits == 0) {
+      continue;
+    }
+    // SECTION_BLOCKS * bits is always a multiple of 8, nothing left to flush
+    unsigned int acc = 0;
+    unsigned int acc_bits = 0;
+    for (int i = 0; i < SECTION_BLOCKS; i++) {
+      acc |= static_cast<unsigned int>(
+                 slots[static_cast<unsigned char>(section[i].material)])
+             << acc_bits;
+      acc_bits += bits;
+      while (acc_bits >= 8) {
+        raw.push_back(static_cast<unsigned char>(acc & 0xff));
+        acc >>= 8;
+        acc_bits -= 8;
+      }
+    }
+  }
+  size_t raw_size = raw.size();
+  dest[0] = (raw_size & 0xff);
+  dest[1] = (raw_size & 0xff00) >> 8;
+  dest[2] = (raw_size & 0xff0000) >> 16;
+  dest[3] = (raw_size & 0xff000000) >> 24;
+  return (4 + lz::compress(raw.data(), raw_size, dest + 4));
+}
+
+bool PaletteCodec::decode(const unsigned char* src, size_t size,
+                          Block* data) const {
+  if (size < 4) {
+    return (false);
+  }
+  size_t raw_size = (static_cast<size_t>(src[0])) |
+                    (static_cast<size_t>(src[1]) << 8) |
+                    (static_cast<size_t>(src[2]) << 16) |
+                    (static_cast<size_t>(src[3]) << 24);
+  if (raw_size > PALETTE_RAW_MAX) {
+    return (false);
+  }
+  std::vector<unsigned char> raw(PALETTE_RAW_MAX);
+  if (lz::decompress(src + 4, size - 4, raw.data(), raw.size()) != raw_size) {
+    return (false);
+  }
+  size_t offset = 0;
+  for (int section_id = 0; section_id < MODEL_PER_CHUNK; section_id++) {
+    Block* section = data + section_id * SECTION_BLOCKS;
+    if (offset >= raw_size) {
+      return (false);
+    }
+    size_t palette_size = static_cast<size_t>(raw[offset]) + 1;
+    const unsigned char* palette = &raw[offset + 1];
+    offset += 1 + palette_size;
+    unsigned int bits = bits_for(palette_size);
+    if (offset + (SECTION_BLOCKS * bits) / 8 > raw_size) {
+      return (false);
+    }
+    if (bits == 0) {
+      for (int i = 0; i < SECTION_BLOCKS; i++) {
+        section[i].material = static_cast<Material>(palette[0]);
+      }
+      continue;
+    }
+    unsigned int mask = (1u << bits) - 1;
+    unsigned int acc = 0;
+    unsigned int acc_bits = 0;
+    for (int i = 0; i < SECTION_BLOCKS; i++) {
+      while (acc_bits < bits) {
+        acc |= static_cast<unsigned int>(raw[offset++]) << acc_bits;
+        acc_bits += 8;
+      }
+      unsigned int index = acc & mask;
+      acc >>= bits;
+      acc_bits -= bits;
+      if (index >= palette_size) {
+        return (false);
+      }
+      section[i].material = static_cast<Material>(palette[index]);
+    }
+  }
+  return (true);
+}
+
+const ChunkCodec* getChunkCodec(CodecId id) {
+  static const RLECodec rle;
+  static const PaletteCodec palette;
+  switch (id) {
+    case CodecId::RLE:
+      return (&rle);
+    case CodecId::Palette:
+      return (&palette);
+    default:
+      return (nullptr);
+  }
+}
+
+const char* getCodecName(CodecId id) {
+  if (id == CodecId::Delta) {
+    return ("delta");
+  }
+  const ChunkCodec* codec = getChunkCodec(id);
+  return (codec != nullptr ? codec->name() : "unknown");
+}
+
+namespace lz {
+// LZ77 byte format in the spirit of LZ4, each sequence is:
+//   [token: literal length (4 bits) | match length - 4 (4 bits)]
+//   [literal length extension][literals][offset (16 bits)]
+//   [match length extension]
+// where 15 in a token nibble means "add the following bytes until one is
+// below 255". The last sequence only carries literals.
+
+#define LZ_MIN_MATCH 4
+#define LZ_HASH_BITS 12
+
+size_t maxCompressedSize(size_t size) { return (size + size / 255 + 16); }
+
+inline size_t write_length(size_t len, unsigned char* dest) {
+  size_t written = 0;
+  while (len >= 255) {
+    dest[written++] = 255;
+    len -= 255;
+  }
+  dest[written++] = static_cast<unsigned char>(len);
+  return (written);
+}
+
+inline size_t write_sequence(const unsigned char* literals, size_t lit_len,
+                             size_t offset, size_t match_len,
+                             unsigned char* dest) {
+  size_t op = 0;
+  unsigned char* token = &dest[op++];
+  *token = static_cast<unsigned char>((lit_len >= 15 ? 15 : lit_len) << 4);
+  if (lit_len >= 15) {
+    op += write_length(lit_len - 15, dest + op);
+  }
+  std::memcpy(dest + op, literals, lit_len);
+  op += lit_len;
+  if (match_len == 0) {
+    return (op);
+  }
+  dest[op++] = (offset & 0xff);
+  dest[op++] = (offset & 0xff00) >> 8;
+  size_t len = match_len - LZ_MIN_MATCH;
+  *token |= static_cast<unsigned char>(len >= 15 ? 15 : len);
+  if (len >= 15) {
+    op += write_length(len - 15, dest + op);
+  }
+  return (op);
+}
+
+size_t compress(const unsigned char* src, size_t size, unsigned char* dest) {
+  std::vector<int> table(1 << LZ_HASH_BITS, -1);
+  size_t ip = 0;
+  size_t anchor = 0;
+  size_t op = 0;
+  while (ip + LZ_MIN_MATCH <= size) {
+    uint32_t sequence;
+    std::memcpy(&sequence, src + ip, sizeof(sequence));
+    uint32_t hash = (sequence * 2654435761u) >> (32 - LZ_HASH_BITS);
+    int ref = table[hash];
+    table[hash] = static_cast<int>(ip);
+    if (ref >= 0 && ip - ref <= 0xffff &&
+        std::memcmp(src + ref, src + ip, LZ_MIN_MATCH) == 0) {
+      size_t len = LZ_MIN_MATCH;
+      while (ip + len < size && src[ref + len] == src[ip + len]) {
+        len++;
+      }
+      op += write_sequence(src + anchor, ip - anchor, ip - ref, len, dest + op);
+      ip += len;
+      anchor = ip;
+    } else {
+      ip++;
+    }
+  }
+  op += write_sequence(src + anchor, size - anchor, 0, 0, dest + op);
+  return (op);
+}
+
+inline bool read_length(const unsigned char* src, size_t size, size_t& ip,
+                        size_t& len) {
+  unsigned char byte;
+  do {
+    if (ip >= size) {
+      return (false);
+    }
+    byte = src[ip++];
+    len += byte;
+  } while (byte == 255);
+  return (true);
+}
+
+size_t decompress(const unsigned char* src, size_t size, unsigned char* dest,
+                  size_t capacity) {
+  size_t ip = 0;
+  size_t op = 0;
+  while (ip < size) {
+    unsigned char token = src[ip++];
+    size_t lit_len = token >> 4;
+    if (lit_len == 15 && !read_length(src, size, ip, lit_len)) {
+      return (0);
+    }
+    if (ip + lit_len > size || op + lit_len > capacity) {
+      return (0);
+    }
+    std::memcpy(dest + op, src + ip, lit_len);
+    ip += lit_len;
+    op += lit_len;
+    if (ip == size) {
+      break;
+    }
+    if (ip + 2 > size) {
+      return (0);
+    }
+    size_t offset = static_cast<size_t>(src[ip]) |
+                    (static_cast<size_t>(src[ip + 1]) << 8);
+    ip += 2;
+    size_t match_len = token & 0xf;
+    if (match_len == 15 && !read_length(src, size, ip, match_len)) {
+      return (0);
+    }
+    match_len += LZ_MIN_MATCH;
+    if (offset == 0 || offset > op || op + match_len > capacity) {
+      return (0);
+    }
+    // Byte by byte, matches may overlap their own output
+    for (size_t i = 0; i < match_len; i++) {
+      dest[op + i] = dest[op - offset + i];
+    }
+    op += match_len;
+  }
+  return (op);
+}
+}  // namespace lz
@@ -0,0 +1,60 @@
+#pragma once
+#include <cstring>
+#include <vector>
+#include "ft_vox.hpp"
+#include "io.hpp"
+
+// Stored in the region header, never renumber.
+// Delta is not a block codec: chunks only store their BlockEdits
+// (io::encodeEdits) and are regenerated on load.
+enum class CodecId : unsigned char { RLE = 0, Palette = 1, Delta = 2 };
+#define CODEC_COUNT 3
+
+// Chunk serialization, implementations are stateless and thread safe
+class ChunkCodec {
+ public:
+  virtual ~ChunkCodec(void){};
+  virtual CodecId id() const = 0;
+  virtual const char* name() const = 0;
+  // Upper bound of encode() output, dest must be at least that large
+  virtual size_t maxEncodedSize() const = 0;
+  virtual size_t encode(const Block* data, unsigned char* dest) const = 0;
+  virtual bool decode(const unsigned char* src, size_t size,
+                      Block* data) const = 0;
+};
+
+// Legacy (count, material) byte pairs, see io::encodeRLE
+class RLECodec : public ChunkCodec {
+ public:
+  CodecId id() const { return (CodecId::RLE); };
+  const char* name() const { return ("rle"); };
+  size_t maxEncodedSize() const { return (CHUNK_BLOCKS * 2); };
+  size_t encode(const Block* data, unsigned char* dest) const;
+  bool decode(const unsigned char* src, size_t size, Block* data) const;
+};
+
+// Per section (16x16x16) palette followed by bit-packed palette indices,
+// the whole stream then goes through an LZ pass.
+// Layout before LZ, for each section:
+//   [palette size - 1][palette materials...][indices, ceil(log2(size)) bits]
+// A single material section stores no indices at all.
+class PaletteCodec : public ChunkCodec {
+ public:
+  CodecId id() const { return (CodecId::Palette); };
+  const char* name() const { return ("palette"); };
+  size_t maxEncodedSize() const;
+  size_t encode(const Block* data, unsigned char* dest) const;
+  bool decode(const unsigned char* src, size_t size, Block* data) const;
+};
+
+// nullptr for Delta
+const ChunkCodec* getChunkCodec(CodecId id);
+const char* getCodecName(CodecId id);
+
+namespace lz {
+size_t maxCompressedSize(size_t size);
+size_t compress(const unsigned char* src, size_t size, unsigned char* dest);
+// Returns the decompressed size or 0 on malformed input
+size_t decompress(const unsigned char* src, size_t size, unsigned char* dest,
+                  size_t capacity);
+}  // namespace lz
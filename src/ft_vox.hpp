@@ -1,5 +1,8 @@
 #pragma once
 #define GLM_ENABLE_EXPERIMENTAL
+#include <cstdint>
+#include <functional>
+#include <map>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
@@ -10,9 +13,29 @@
 #define CHUNK_HEIGHT 256
 #define MODEL_HEIGHT 16
 #define REGION_SIZE 16
+#define CHUNK_UNLOAD_MARGIN 2  // chunks past render distance before unload
+#define CHUNK_UNLOAD_DELAY 5000  // ms spent past the margin before unload
+#define CHUNK_RELOAD_WINDOW 10000  // ms, reloads sooner than that are counted
+#define RENDER_DISTANCE_MAX 20
+#define SPAWN_CLEARANCE 3  // Blocks between the ground and the spawn camera
 #define CHUNK_PER_REGION REGION_SIZE* REGION_SIZE
 #define REGION_LOOKUPTABLE_SIZE CHUNK_PER_REGION * 3
 #define MODEL_PER_CHUNK CHUNK_HEIGHT / MODEL_HEIGHT
+#define CHUNK_BLOCKS (CHUNK_SIZE * CHUNK_SIZE * CHUNK_HEIGHT)
+#define SECTION_BLOCKS (CHUNK_SIZE * CHUNK_SIZE * MODEL_HEIGHT)
+#define JOURNAL_BATCH_SIZE 4096       // edits
+#define JOURNAL_FLUSH_INTERVAL 500    // ms
+#define JOURNAL_COMPACT_SIZE 262144   // edits
+#define CHUNK_CACHE_BUDGET (64 * 1024 * 1024)  // bytes
+#define CHUNK_CACHE_CODEC CodecId::Palette
+#define CHUNK_CACHE_INFLATE 8  // cache hits inflated per frame
+#define SCHEDULER_TARGET_FPS 60.0f
+#define SCHEDULER_MIN_BUDGET 1.0f   // ms
+#define SCHEDULER_MAX_BUDGET 12.0f  // ms
+#define PREFETCH_HORIZON 2.0f  // s of travel the queues look ahead
+#define PREFETCH_VIEW_AHEAD 2  // chunks, toward the view direction
+#define JOBS_PER_THREAD 2           // Chunk jobs submitted ahead per worker
+#define RAYCAST_TASK_RAYS 256       // Rays per task of a parallel batch
 
 enum class BlockSide : unsigned int { Front, Back, Left, Right, Bottom, Up };
 
@@ -46,6 +69,29 @@ struct Block {
   Block() : material(Material::Air){};
 };
 
+// Player modifications of a chunk since generation, by FileLayout index
+// (layout.hpp) since they are saved as is
+typedef std::map<uint16_t, enum Material> BlockEdits;
+
+struct ivec2Comparator {
+  // Keys are multiples of 16 (chunks) or 256 (regions), every bit is
+  // mixed so the low ones used for bucketing are not always 0
+  size_t operator()(const glm::ivec2& k) const {
+    uint64_t h = (static_cast<uint64_t>(static_cast<uint32_t>(k.x)) << 32) |
+                 static_cast<uint32_t>(k.y);
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return (static_cast<size_t>(h));
+  }
+
+  bool operator()(const glm::ivec2& a, const glm::ivec2& b) const {
+    return (a.x == b.x && a.y == b.y);
+  }
+};
+
 struct Texture_lookup {
   int side[6];
 };
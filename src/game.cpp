@@ -2,13 +2,13 @@
 
 Game::Game(void) : Game(42) {}
 
-Game::Game(uint32_t seed) : _chunkManager(seed) {
+Game::Game(uint32_t seed) : _chunkManager(seed), _spawned(false) {
   _camera =
       new Camera(glm::vec3(0.0f, 125.0f, 1.0f), glm::vec3(0.0f, 125.0f, 0.0f));
   faceRenderAttrib.vaos.push_back(new VAO({{0.0f, 0.0f, 0.0f}}));
 }
 
-Game::Game(Game const& src) { *this = src; }
+Game::Game(Game const& src) : _spawned(false) { *this = src; }
 
 Game::~Game(void) { delete _camera; }
 
@@ -17,16 +17,27 @@ Game& Game::operator=(Game const& rhs) {
     this->_chunkManager = rhs._chunkManager;
     this->_debugMode = rhs._debugMode;
     this->_camera = new Camera(*rhs._camera);
+    this->_spawned = rhs._spawned;
   }
   return (*this);
 }
 
 void Game::update(Env& env) {
+  // Ground height is known once the spawn chunk is generated
+  if (!_spawned) {
+    int height = _chunkManager.getSurfaceHeight(
+        static_cast<int>(std::floor(_camera->pos.x)),
+        static_cast<int>(std::floor(_camera->pos.z)));
+    if (height >= 0) {
+      _camera->pos.y = static_cast<float>(height + 1 + SPAWN_CLEARANCE);
+      _spawned = true;
+    }
+  }
   _camera->update(env);
   static float rotx = 0.0;
   static float roty = 0.0;
   static float rotz = 0.0;
-  _chunkManager.update(_camera->pos);
+  _chunkManager.update(_camera->pos, _camera->dir, env.getDeltaTime());
   struct HitInfo hit_cube =
       _chunkManager.rayCast(_camera->dir, _camera->pos, 5.0f);
   _last_hit = hit_cube;
@@ -61,6 +72,14 @@ void Game::update(Env& env) {
       _chunkManager.point_exploding(add_cube.pos, 10.f);
     }
   }
+  if (env.inputHandler.keys[GLFW_KEY_C]) {
+    env.inputHandler.keys[GLFW_KEY_C] = false;
+    _chunkManager.toggleCodec();
+  }
+  if (env.inputHandler.keys[GLFW_KEY_P]) {
+    env.inputHandler.keys[GLFW_KEY_P] = false;
+    _chunkManager.togglePrefetch();
+  }
   if (env.inputHandler.keys[GLFW_KEY_I]) {
     env.inputHandler.keys[GLFW_KEY_I] = false;
     _debugMode = !_debugMode;
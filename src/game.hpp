@@ -20,5 +20,6 @@ class Game {
   Camera* _camera;
   RenderAttrib faceRenderAttrib;
   struct HitInfo _last_hit;
+  bool _spawned;  // Camera moved above the ground of its column
   void print_debug_info(const Env& env, Renderer& renderer, Camera& camera);
 };
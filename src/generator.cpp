@@ -7,6 +7,12 @@ namespace generator {
 		{{1.0f, 1.0f, 1.0f}}, {{1.0f, 1.0f, 1.0f}},
 		{{1.0f, 1.0f, 1.0f}}};
 	std::vector<int> permutation;
+	uint32_t world_seed;
+
+	// Per chunk random stream, a chunk must regenerate identically
+	inline float random01(std::minstd_rand &rng) {
+		return (std::uniform_real_distribution<float>(0.0f, 1.0f)(rng));
+	}
 
 	inline float noise2D(const glm::vec2 &v) {
 		uint32_t s = static_cast<uint32_t>(v.x) * 1087;
@@ -52,7 +58,7 @@ namespace generator {
 	float fade(float t) { return t * t * t * (t * (t * 6 - 15) + 10); }
 
 	inline Block get_block(Block *data, glm::ivec3 index) {
-		return data[index.y * CHUNK_SIZE * CHUNK_SIZE + index.x * CHUNK_SIZE + index.z];
+		return data[BlockLayout::index(index)];
 	}
 
 	float grad(int hash, float x, float y, float z) {
@@ -208,8 +214,8 @@ namespace generator {
 	}
 
 
-	void gen_boule(glm::ivec3 pos, Block *data) {
-		float age = static_cast<int>((rand() / static_cast<float>(RAND_MAX)) * 2.0) + 5;
+	void gen_boule(glm::ivec3 pos, Block *data, std::minstd_rand &rng) {
+		float age = static_cast<int>(random01(rng) * 2.0) + 5;
 		int cube_size = static_cast<int>(age) / 2;
 		Block wood(Material::Wood);
 		Block leaf(Material::Leaf);
@@ -220,7 +226,7 @@ namespace generator {
 		for (int x = pos.x - cube_size; x <= pos.x + cube_size; x++) {
 			for (int y = pos.y + age - cube_size + 2 ; y <= pos.y + age + cube_size; y++) {
 				for (int z = pos.z - cube_size; z <= pos.z + cube_size; z++) {
-					if (rand() / static_cast<float>(RAND_MAX) * 0.7 + 1.0 > glm::distance(glm::vec3(x, y, z),
+					if (random01(rng) * 0.7 + 1.0 > glm::distance(glm::vec3(x, y, z),
 								glm::vec3(pos.x, pos.y + age, pos.z)) / (float)cube_size) {
 						set_block(data, leaf, glm::ivec3(x, y, z));
 					}
@@ -228,8 +234,8 @@ namespace generator {
 			}
 		}
 	}
-	void gen_procedural(glm::ivec3 pos, Block *data) {
-		float age = static_cast<int>((rand() / static_cast<float>(RAND_MAX)) * 2.0) + 5;
+	void gen_procedural(glm::ivec3 pos, Block *data, std::minstd_rand &rng) {
+		float age = static_cast<int>(random01(rng) * 2.0) + 5;
 		int cube_size = static_cast<int>(age) / 1.5;
 		Block wood(Material::Wood);
 		Block leaf(Material::Leaf);
@@ -251,19 +257,22 @@ namespace generator {
 
 
 
-	void gen_tree(glm::ivec3 pos, treeType type, Block *data) {
+	void gen_tree(glm::ivec3 pos, treeType type, Block *data, std::minstd_rand &rng) {
 		switch (type) {
 			case treeType::BOULE:
-				gen_boule(pos, data);
+				gen_boule(pos, data, rng);
 				break;
 			case treeType::PROCEDURAL:
-				gen_procedural(pos, data);
+				gen_procedural(pos, data, rng);
 				break;
 			default :;
 		}
 	}
 
 	void generate_chunk(Block *data, Biome *biome_data, glm::vec3 pos) {
+		std::minstd_rand rng(world_seed ^
+				(static_cast<uint32_t>(static_cast<int>(pos.x)) * 73856093u) ^
+				(static_cast<uint32_t>(static_cast<int>(pos.z)) * 19349663u));
 		pos += permutation.size() / 2;
 		for (int x = 0; x < 16; x++) {
 			for (int z = 0; z < 16; z++) {
@@ -327,25 +336,26 @@ namespace generator {
 						1.f, {0.5f, 0.5f});
 
 				if (density_value > sdensity && n > 0.68 && h_cave < 0.63 && biome == Biome::Forest && x > 2 && x < CHUNK_SIZE - 2 && z > 2 && z < CHUNK_SIZE - 2) {
-					if (rand() / static_cast<float>(RAND_MAX) > 0.6)
-						gen_tree(glm::ivec3(x, height, z), treeType::BOULE, data); 
+					if (random01(rng) > 0.6)
+						gen_tree(glm::ivec3(x, height, z), treeType::BOULE, data, rng);
 					else
-						gen_tree(glm::ivec3(x, height, z), treeType::PROCEDURAL, data); 
+						gen_tree(glm::ivec3(x, height, z), treeType::PROCEDURAL, data, rng);
 				}
 			}
 		}
 	}
 
 	inline void set_block(Block *data, Block block, glm::ivec3 index) {
-		if (!(index.x < 0 || index.y < 0 | index.z < 0 ||
-					index.x >= CHUNK_SIZE || index.z >= CHUNK_SIZE || index.y > CHUNK_HEIGHT))
-			data[index.y * CHUNK_SIZE * CHUNK_SIZE + index.x * CHUNK_SIZE + index.z] =
-				block;
+		if (!(index.x < 0 || index.y < 0 || index.z < 0 ||
+					index.x >= CHUNK_SIZE || index.z >= CHUNK_SIZE || index.y >= CHUNK_HEIGHT))
+			data[BlockLayout::index(index)] = block;
 	}
 
 
 
 	void init(uint32_t size, uint32_t seed) {
+		world_seed = seed;
+		permutation.clear();
 		permutation.resize(size / 2);
 		std::iota(permutation.begin(), permutation.end(), 0);
 		std::default_random_engine engine(seed);
@@ -5,6 +5,7 @@
 #include <random>
 #include <vector>
 #include "ft_vox.hpp"
+#include "layout.hpp"
 
 namespace generator {
 
@@ -23,42 +23,325 @@ unsigned int get_filesize(std::string filename) {
   return (0);
 }
 
+static_assert(sizeof(Block) == 1, "RLE works on raw material bytes");
+
+inline unsigned int first_set_bit(unsigned int mask) {
+#if defined(_MSC_VER)
+  unsigned long index;
+  _BitScanForward(&index, mask);
+  return (static_cast<unsigned int>(index));
+#else
+  return (static_cast<unsigned int>(__builtin_ctz(mask)));
+#endif
+}
+
+// Index of the first byte different from value in [start, end)
+inline size_t run_end(const unsigned char* bytes, size_t start, size_t end,
+                      unsigned char value) {
+  size_t i = start;
+#if defined(__AVX2__)
+  const __m256i wide_value = _mm256_set1_epi8(static_cast<char>(value));
+  for (; i + 32 <= end; i += 32) {
+    __m256i block =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(bytes + i));
+    unsigned int mask = static_cast<unsigned int>(
+        _mm256_movemask_epi8(_mm256_cmpeq_epi8(block, wide_value)));
+    if (mask != 0xffffffffu) {
+      return (i + first_set_bit(~mask));
+    }
+  }
+#endif
+#if defined(__SSE2__)
+  const __m128i vector_value = _mm_set1_epi8(static_cast<char>(value));
+  for (; i + 16 <= end; i += 16) {
+    __m128i block =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes + i));
+    unsigned int mask = static_cast<unsigned int>(
+        _mm_movemask_epi8(_mm_cmpeq_epi8(block, vector_value)));
+    if (mask != 0xffff) {
+      return (i + first_set_bit(~mask & 0xffff));
+    }
+  }
+#endif
+  while (i < end && bytes[i] == value) {
+    i++;
+  }
+  return (i);
+}
+
+// Runs are emitted as (count, material) pairs of at most 255 blocks.
+// The last pair is never written (historical format quirk): decoding leaves
+// the tail of the chunk untouched, ie. air.
 size_t encodeRLE(const Block* data, unsigned char* dest) {
+  const unsigned char* bytes = reinterpret_cast<const unsigned char*>(data);
   size_t len_rle = 0;
-  for (size_t i = 0; i < (CHUNK_SIZE * CHUNK_SIZE * CHUNK_HEIGHT); i++) {
-    unsigned char c = 1;
-    while (data[i] == data[i + 1] && c < 255) {
-      c++;
-      i++;
+  size_t i = 0;
+  while (i < CHUNK_BLOCKS) {
+    unsigned char value = bytes[i];
+    size_t run = run_end(bytes, i + 1, CHUNK_BLOCKS, value) - i;
+    i += run;
+    for (; run >= 255; run -= 255) {
+      dest[len_rle] = 255;
+      dest[len_rle + 1] = value;
+      len_rle += 2;
+    }
+    if (run > 0) {
+      dest[len_rle] = static_cast<unsigned char>(run);
+      dest[len_rle + 1] = value;
+      len_rle += 2;
     }
-    dest[len_rle] = c;
-    dest[len_rle + 1] = static_cast<unsigned char>(data[i].material);
-    len_rle += 2;
   }
   return (len_rle - 2);
 }
 
-void decodeRLE(unsigned char* encoded_data, size_t rle_size, Block* data,
+void decodeRLE(const unsigned char* encoded_data, size_t rle_size, Block* data,
                unsigned int limit) {
+  unsigned char* bytes = reinterpret_cast<unsigned char*>(data);
   size_t data_offset = 0;
-  for (unsigned int i = 0; i < rle_size; i += 2) {
-    unsigned char len = encoded_data[i];
-    unsigned char value = encoded_data[i + 1];
-    for (int j = 0; j < len; j++) {
-      if (data_offset >= limit) return;
-      data[data_offset].material = static_cast<Material>(value);
-      data_offset++;
+  for (size_t i = 0; i + 1 < rle_size; i += 2) {
+    size_t len = encoded_data[i];
+    if (data_offset + len >= limit) {
+      std::memset(bytes + data_offset, encoded_data[i + 1],
+                  limit - data_offset);
+      return;
+    }
+    std::memset(bytes + data_offset, encoded_data[i + 1], len);
+    data_offset += len;
+  }
+}
+
+inline size_t write_varint(unsigned int value, unsigned char* dest) {
+  size_t written = 0;
+  while (value >= 0x80) {
+    dest[written++] = static_cast<unsigned char>(value | 0x80);
+    value >>= 7;
+  }
+  dest[written++] = static_cast<unsigned char>(value);
+  return (written);
+}
+
+inline bool read_varint(const unsigned char* src, size_t size, size_t& offset,
+                        unsigned int& value) {
+  value = 0;
+  for (unsigned int shift = 0; shift < 32; shift += 7) {
+    if (offset >= size) {
+      return (false);
+    }
+    unsigned char byte = src[offset++];
+    value |= static_cast<unsigned int>(byte & 0x7f) << shift;
+    if ((byte & 0x80) == 0) {
+      return (true);
+    }
+  }
+  return (false);
+}
+
+size_t maxEditsSize(const BlockEdits& edits) {
+  return (5 + edits.size() * 4);
+}
+
+// [edit count][for each edit: index delta from previous edit, material]
+// with varint counts and deltas, edits being sorted by block index
+size_t encodeEdits(const BlockEdits& edits, unsigned char* dest) {
+  size_t len = write_varint(static_cast<unsigned int>(edits.size()), dest);
+  unsigned int previous = 0;
+  for (const auto& edit : edits) {
+    len += write_varint(edit.first - previous, dest + len);
+    dest[len++] = static_cast<unsigned char>(edit.second);
+    previous = edit.first;
+  }
+  return (len);
+}
+
+bool decodeEdits(const unsigned char* src, size_t size, BlockEdits& edits) {
+  size_t offset = 0;
+  unsigned int count;
+  if (!read_varint(src, size, offset, count) || count > CHUNK_BLOCKS) {
+    return (false);
+  }
+  unsigned int index = 0;
+  for (unsigned int i = 0; i < count; i++) {
+    unsigned int delta;
+    if (!read_varint(src, size, offset, delta) || offset >= size) {
+      return (false);
+    }
+    index += delta;
+    if (index >= CHUNK_BLOCKS) {
+      return (false);
+    }
+    edits[static_cast<uint16_t>(index)] = static_cast<Material>(src[offset++]);
+  }
+  return (true);
+}
+
+#define JOURNAL_ENTRY_SIZE 10
+
+inline void write_u32(uint32_t value, unsigned char* dest) {
+  dest[0] = (value & 0xff);
+  dest[1] = (value & 0xff00) >> 8;
+  dest[2] = (value & 0xff0000) >> 16;
+  dest[3] = (value & 0xff000000) >> 24;
+}
+
+inline uint32_t read_u32(const unsigned char* src) {
+  return (static_cast<uint32_t>(src[0]) | (static_cast<uint32_t>(src[1]) << 8) |
+          (static_cast<uint32_t>(src[2]) << 16) |
+          (static_cast<uint32_t>(src[3]) << 24));
+}
+
+inline uint32_t fnv1a(const unsigned char* data, size_t size) {
+  uint32_t hash = 2166136261u;
+  for (size_t i = 0; i < size; i++) {
+    hash = (hash ^ data[i]) * 16777619u;
+  }
+  return (hash);
+}
+
+// Journal batches: [entry count][entries][fnv1a of entries], an entry being
+// [x (4 bytes)][z (4 bytes)][y][material]. A batch torn by a crash fails
+// its checksum and ends the replay.
+bool appendJournal(std::string filename,
+                   const std::vector<JournalEntry>& entries) {
+  std::vector<unsigned char> batch(8 + entries.size() * JOURNAL_ENTRY_SIZE);
+  write_u32(static_cast<uint32_t>(entries.size()), batch.data());
+  unsigned char* records = batch.data() + 4;
+  for (size_t i = 0; i < entries.size(); i++) {
+    unsigned char* record = records + i * JOURNAL_ENTRY_SIZE;
+    write_u32(static_cast<uint32_t>(entries[i].pos.x), record);
+    write_u32(static_cast<uint32_t>(entries[i].pos.z), record + 4);
+    record[8] = static_cast<unsigned char>(entries[i].pos.y);
+    record[9] = static_cast<unsigned char>(entries[i].material);
+  }
+  write_u32(fnv1a(records, entries.size() * JOURNAL_ENTRY_SIZE),
+            records + entries.size() * JOURNAL_ENTRY_SIZE);
+  FILE* journal = fopen(filename.c_str(), "ab");
+  if (journal == NULL) {
+    return (false);
+  }
+  bool written = fwrite(batch.data(), batch.size(), 1, journal) == 1;
+  fflush(journal);
+#if defined(__APPLE__) || defined(__linux__)
+  fsync(fileno(journal));
+#endif
+  fclose(journal);
+  return (written);
+}
+
+void readJournal(std::string filename, std::vector<JournalEntry>& entries) {
+  MappedFile journal;
+  if (mapFile(filename, journal) == false) {
+    return;
+  }
+  size_t offset = 0;
+  while (offset + 8 <= journal.size) {
+    size_t count = read_u32(journal.data + offset);
+    size_t records_size = count * JOURNAL_ENTRY_SIZE;
+    if (count > journal.size ||
+        offset + 8 + records_size > journal.size) {
+      break;
+    }
+    const unsigned char* records = journal.data + offset + 4;
+    if (fnv1a(records, records_size) != read_u32(records + records_size)) {
+      break;
+    }
+    for (size_t i = 0; i < count; i++) {
+      const unsigned char* record = records + i * JOURNAL_ENTRY_SIZE;
+      JournalEntry entry;
+      entry.pos.x = static_cast<int32_t>(read_u32(record));
+      entry.pos.z = static_cast<int32_t>(read_u32(record + 4));
+      entry.pos.y = record[8];
+      entry.material = static_cast<Material>(record[9]);
+      entries.push_back(entry);
     }
+    offset += 8 + records_size;
+  }
+  unmapFile(journal);
+}
+
+void truncateFile(std::string filename) {
+  FILE* file = fopen(filename.c_str(), "wb");
+  if (file != NULL) {
+    fclose(file);
+  }
+}
+
+bool syncFile(FILE* file) {
+  if (fflush(file) != 0) {
+    return (false);
+  }
+#if defined(__APPLE__) || defined(__linux__)
+  return (fsync(fileno(file)) == 0);
+#else
+  return (true);
+#endif
+}
+
+bool syncDirectory(std::string filename) {
+#if defined(__APPLE__) || defined(__linux__)
+  size_t slash = filename.find_last_of('/');
+  std::string directory =
+      slash == std::string::npos ? "." : filename.substr(0, slash + 1);
+  int fd = open(directory.c_str(), O_RDONLY);
+  if (fd == -1) {
+    return (false);
+  }
+  bool synced = fsync(fd) == 0;
+  close(fd);
+  return (synced);
+#else
+  return (true);
+#endif
+}
+
+bool mapFile(std::string filename, MappedFile& file) {
+  file.data = nullptr;
+  file.size = 0;
+#if defined(__APPLE__) || defined(__linux__)
+  int fd = open(filename.c_str(), O_RDONLY);
+  if (fd == -1) {
+    return (false);
+  }
+  struct stat st = {0};
+  if (fstat(fd, &st) == -1 || st.st_size == 0) {
+    close(fd);
+    return (false);
+  }
+  void* addr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);  // The mapping keeps its own reference to the file
+  if (addr == MAP_FAILED) {
+    return (false);
   }
+  file.data = static_cast<const unsigned char*>(addr);
+  file.size = st.st_size;
+#else
+  FILE* f = fopen(filename.c_str(), "rb");
+  if (f == NULL) {
+    return (false);
+  }
+  unsigned int filesize = get_filesize(filename);
+  unsigned char* buffer = new unsigned char[filesize];
+  if (filesize == 0 || fread(buffer, filesize, 1, f) != 1) {
+    delete[] buffer;
+    fclose(f);
+    return (false);
+  }
+  fclose(f);
+  file.data = buffer;
+  file.size = filesize;
+#endif
+  return (true);
 }
 
-void initRegionFile(std::string filename) {
-  unsigned char lookup[REGION_LOOKUPTABLE_SIZE] = {0};
-  FILE* region = fopen(filename.c_str(), "w+b");
-  if (region != NULL) {
-    fwrite(lookup, REGION_LOOKUPTABLE_SIZE, 1, region);
-    fclose(region);
+void unmapFile(MappedFile& file) {
+  if (file.data != nullptr) {
+#if defined(__APPLE__) || defined(__linux__)
+    munmap(const_cast<unsigned char*>(file.data), file.size);
+#else
+    delete[] file.data;
+#endif
   }
+  file.data = nullptr;
+  file.size = 0;
 }
 
 }  // namespace io
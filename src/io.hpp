@@ -1,23 +1,61 @@
 #pragma once
 #if defined(__APPLE__) || defined(__linux__)
+#include <fcntl.h>
+#include <sys/mman.h>
 #include <unistd.h>
 #elif defined(_WIN32)
 #include <direct.h>
 #endif
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <cstring>
 #include <iostream>
 #include <string>
+#include <vector>
 #include "ft_vox.hpp"
 
 namespace io {
+// Read-only view of a whole file, mmap'ed where available
+struct MappedFile {
+  const unsigned char* data = nullptr;
+  size_t size = 0;
+};
+
+// One player edit, in world coordinates
+struct JournalEntry {
+  glm::ivec3 pos;
+  enum Material material;
+};
+
 bool exists(std::string filename);
 void makedir(std::string filename);
 unsigned int get_filesize(std::string filename);
 
 size_t encodeRLE(const Block* data, unsigned char* dest);
-void decodeRLE(unsigned char* encoded_data, size_t rle_size, Block* data,
+void decodeRLE(const unsigned char* encoded_data, size_t rle_size, Block* data,
                unsigned int limit);
 
-void initRegionFile(std::string filename);
+size_t maxEditsSize(const BlockEdits& edits);
+size_t encodeEdits(const BlockEdits& edits, unsigned char* dest);
+bool decodeEdits(const unsigned char* src, size_t size, BlockEdits& edits);
+
+bool appendJournal(std::string filename,
+                   const std::vector<JournalEntry>& entries);
+void readJournal(std::string filename, std::vector<JournalEntry>& entries);
+void truncateFile(std::string filename);
+// Written data, or the entries of the directory holding filename, are on
+// the disk once these return true
+bool syncFile(FILE* file);
+bool syncDirectory(std::string filename);
+
+bool mapFile(std::string filename, MappedFile& file);
+void unmapFile(MappedFile& file);
 }  // namespace io
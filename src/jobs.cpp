@@ -0,0 +1,99 @@
+#include "jobs.hpp"
+
+JobSystem::JobSystem(void)
+    : JobSystem(std::thread::hardware_concurrency() > 1
+                    ? std::thread::hardware_concurrency() - 1
+                    : 1) {}
+
+JobSystem::JobSystem(unsigned int threads)
+    : _queued(0), _running_jobs(0), _next(0), _stolen(0), _running(true) {
+  for (unsigned int i = 0; i < threads; i++) {
+    _workers.push_back(std::unique_ptr<Worker>(new Worker));
+  }
+  // Started once every deque exists, workers steal from each other
+  for (unsigned int i = 0; i < threads; i++) {
+    _workers[i]->thread = std::thread(&JobSystem::run, this, i);
+  }
+}
+
+JobSystem::~JobSystem(void) {
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _running = false;
+  }
+  _cv.notify_all();
+  for (auto& worker : _workers) {
+    worker->thread.join();
+  }
+}
+
+void JobSystem::submit(std::function<void()> job) {
+  size_t index = _next++ % _workers.size();
+  {
+    std::lock_guard<std::mutex> lock(_workers[index]->mutex);
+    _workers[index]->jobs.push_back(std::move(job));
+  }
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _queued++;
+  }
+  _cv.notify_one();
+}
+
+bool JobSystem::popJob(unsigned int index, std::function<void()>& job) {
+  {
+    Worker& worker = *_workers[index];
+    std::lock_guard<std::mutex> lock(worker.mutex);
+    if (worker.jobs.empty() == false) {
+      job = std::move(worker.jobs.back());
+      worker.jobs.pop_back();
+      return (true);
+    }
+  }
+  for (size_t i = 1; i < _workers.size(); i++) {
+    Worker& victim = *_workers[(index + i) % _workers.size()];
+    std::lock_guard<std::mutex> lock(victim.mutex);
+    if (victim.jobs.empty() == false) {
+      job = std::move(victim.jobs.front());
+      victim.jobs.pop_front();
+      _stolen++;
+      return (true);
+    }
+  }
+  return (false);
+}
+
+void JobSystem::run(unsigned int index) {
+  while (1) {
+    {
+      std::unique_lock<std::mutex> lock(_mutex);
+      _cv.wait(lock, [this] { return (!_running || _queued > 0); });
+      if (_running == false) {
+        return;
+      }
+    }
+    std::function<void()> job;
+    if (popJob(index, job) == false) {
+      // Taken by another worker in the meantime
+      continue;
+    }
+    _running_jobs++;
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _queued--;
+    }
+    job();
+    _running_jobs--;
+  }
+}
+
+size_t JobSystem::pending() {
+  std::lock_guard<std::mutex> lock(_mutex);
+  return (_queued + _running_jobs);
+}
+
+unsigned int JobSystem::getThreadCount() const {
+  return (static_cast<unsigned int>(_workers.size()));
+}
+
+size_t JobSystem::getStolenCount() const { return (_stolen); }
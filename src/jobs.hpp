@@ -0,0 +1,46 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed pool of worker threads, each with its own job deque. Jobs are
+// dealt round robin, a worker runs its own jobs newest first and steals
+// the oldest job of another worker once its deque is empty.
+// Jobs must not touch render thread state, they hand results back
+// through their own queue.
+class JobSystem {
+ public:
+  JobSystem(void);  // One worker per core, minus the render thread
+  JobSystem(unsigned int threads);
+  ~JobSystem(void);  // Queued jobs are dropped, running ones finish
+
+  void submit(std::function<void()> job);
+  size_t pending();  // Queued and running
+  unsigned int getThreadCount() const;
+  size_t getStolenCount() const;
+
+ private:
+  struct Worker {
+    std::mutex mutex;
+    std::deque<std::function<void()> > jobs;
+    std::thread thread;
+  };
+  JobSystem(JobSystem const& src);
+  JobSystem& operator=(JobSystem const& rhs);
+  void run(unsigned int index);
+  bool popJob(unsigned int index, std::function<void()>& job);
+
+  std::vector<std::unique_ptr<Worker> > _workers;
+  std::mutex _mutex;  // Sleeping workers
+  std::condition_variable _cv;
+  size_t _queued;  // Guarded by _mutex
+  std::atomic<size_t> _running_jobs;
+  std::atomic<size_t> _next;
+  std::atomic<size_t> _stolen;
+  bool _running;
+};
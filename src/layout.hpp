@@ -0,0 +1,105 @@
+#pragma once
+#include <type_traits>
+#include "ft_vox.hpp"
+
+// Order of the blocks inside a section, local coordinates (x, z below
+// CHUNK_SIZE, y below MODEL_HEIGHT) to an offset below SECTION_BLOCKS.
+// An order provides:
+//   static constexpr int offset(int x, int y, int z)
+//   static constexpr int x(int offset), y(int offset), z(int offset)
+
+// y, x then z, rows of z are contiguous
+struct LinearOrder {
+  static constexpr int offset(int x, int y, int z) {
+    return (y * CHUNK_SIZE * CHUNK_SIZE + x * CHUNK_SIZE + z);
+  };
+  static constexpr int x(int offset) {
+    return (offset / CHUNK_SIZE % CHUNK_SIZE);
+  };
+  static constexpr int y(int offset) {
+    return (offset / (CHUNK_SIZE * CHUNK_SIZE));
+  };
+  static constexpr int z(int offset) { return (offset % CHUNK_SIZE); };
+};
+
+// Z-order curve, bits of z, x and y interleaved in that order so every
+// aligned 2x2x2 (then 4x4x4, 8x8x8) cube is contiguous
+struct MortonOrder {
+  // 4 bits spread to bits 0, 3, 6 and 9
+  static constexpr int spread(int v) {
+    return ((v & 1) | ((v & 2) << 2) | ((v & 4) << 4) | ((v & 8) << 6));
+  };
+  static constexpr int compact(int v) {
+    return ((v & 1) | ((v >> 2) & 2) | ((v >> 4) & 4) | ((v >> 6) & 8));
+  };
+  static constexpr int offset(int x, int y, int z) {
+    return (spread(z) | (spread(x) << 1) | (spread(y) << 2));
+  };
+  static constexpr int x(int offset) { return (compact(offset >> 1)); };
+  static constexpr int y(int offset) { return (compact(offset >> 2)); };
+  static constexpr int z(int offset) { return (compact(offset)); };
+};
+
+// Flat chunk buffer of CHUNK_BLOCKS: sections bottom to top, so a section
+// is always the contiguous range [id * SECTION_BLOCKS, +SECTION_BLOCKS),
+// blocks of a section in Order
+template <class Order>
+struct ChunkLayout {
+  static constexpr int index(int x, int y, int z) {
+    return (y / MODEL_HEIGHT * SECTION_BLOCKS +
+            Order::offset(x, y % MODEL_HEIGHT, z));
+  };
+  static int index(glm::ivec3 pos) {
+    return (index(pos.x, pos.y, pos.z));
+  };
+  static glm::ivec3 position(int index) {
+    int offset = index % SECTION_BLOCKS;
+    int y = index / SECTION_BLOCKS * MODEL_HEIGHT + Order::y(offset);
+    return (glm::ivec3(Order::x(offset), y, Order::z(offset)));
+  };
+};
+
+#ifndef BLOCK_ORDER
+#define BLOCK_ORDER LinearOrder  // -DBLOCK_ORDER=MortonOrder to change it
+#endif
+
+// Region files and BlockEdits keys, never changes
+typedef ChunkLayout<LinearOrder> FileLayout;
+// Every buffer in memory: generator, mesher, ChunkSections, cache
+typedef ChunkLayout<BLOCK_ORDER> BlockLayout;
+
+// Nothing to convert at the file boundary, callers skip their copies
+constexpr bool file_layout_matches() {
+  return (std::is_same<BLOCK_ORDER, LinearOrder>::value);
+}
+
+// BlockEdits key to a BlockLayout index
+inline int edit_index(uint16_t key) {
+  if (file_layout_matches()) {
+    return (key);
+  }
+  return (BlockLayout::index(FileLayout::position(key)));
+}
+
+// BlockLayout index to a BlockEdits key
+inline uint16_t edit_key(int index) {
+  if (file_layout_matches()) {
+    return (static_cast<uint16_t>(index));
+  }
+  return (static_cast<uint16_t>(
+      FileLayout::index(BlockLayout::position(index))));
+}
+
+// Whole chunk buffer from one layout to the other, dest and src must not
+// overlap
+template <class From, class To>
+void relayout(const Block* src, Block* dest) {
+  for (int y = 0; y < CHUNK_HEIGHT; y++) {
+    for (int x = 0; x < CHUNK_SIZE; x++) {
+      for (int z = 0; z < CHUNK_SIZE; z++) {
+        dest[To::index(x, y, z)] = src[From::index(x, y, z)];
+      }
+    }
+  }
+}
+
@@ -110,9 +110,8 @@ const std::vector<glm::vec3> getFace(glm::ivec3 pos, enum BlockSide side) {
   return (positions);
 }
 
-const std::vector<Vertex> getFace(Chunk *chunk, const Block &block,
-                                  glm::ivec3 pos, enum BlockSide side,
-                                  glm::vec3 scale) {
+const std::vector<Vertex> getFace(const Block &block, glm::ivec3 pos,
+                                  enum BlockSide side, glm::vec3 scale) {
   std::vector<Vertex> vertices;
   std::vector<glm::vec3> positions;
 
@@ -156,21 +155,21 @@ const std::vector<Vertex> getFace(Chunk *chunk, const Block &block,
   return (vertices);
 }
 
-std::vector<Vertex> get_scaled_cube(Chunk *chunk, Block b, glm::vec3 scale,
+std::vector<Vertex> get_scaled_cube(Block b, glm::vec3 scale,
                                     glm::ivec3 pos) {
   std::vector<Vertex> vertices;
 
-  auto quad = getFace(chunk, b, pos, BlockSide::Front, scale);
+  auto quad = getFace(b, pos, BlockSide::Front, scale);
   vertices.insert(vertices.end(), quad.begin(), quad.end());
-  quad = getFace(chunk, b, pos, BlockSide::Right, scale);
+  quad = getFace(b, pos, BlockSide::Right, scale);
   vertices.insert(vertices.end(), quad.begin(), quad.end());
-  quad = getFace(chunk, b, pos, BlockSide::Back, scale);
+  quad = getFace(b, pos, BlockSide::Back, scale);
   vertices.insert(vertices.end(), quad.begin(), quad.end());
-  quad = getFace(chunk, b, pos, BlockSide::Left, scale);
+  quad = getFace(b, pos, BlockSide::Left, scale);
   vertices.insert(vertices.end(), quad.begin(), quad.end());
-  quad = getFace(chunk, b, pos, BlockSide::Bottom, scale);
+  quad = getFace(b, pos, BlockSide::Bottom, scale);
   vertices.insert(vertices.end(), quad.begin(), quad.end());
-  quad = getFace(chunk, b, pos, BlockSide::Up, scale);
+  quad = getFace(b, pos, BlockSide::Up, scale);
   vertices.insert(vertices.end(), quad.begin(), quad.end());
 
   return vertices;
@@ -235,44 +234,34 @@ bool is_fill(std::vector<glm::ivec2> interval_dimension[3], glm::ivec3 pos) {
   return false;
 }
 
-void greedy(Chunk *chunk, RenderAttrib &render_attrib) {
-  size_t total_vertices = 0;
-  enum BlockSide sides[4] = {BlockSide::Left, BlockSide::Right,
-                             BlockSide::Bottom, BlockSide::Up};
+void greedy(Block *data, const bool dirty[MODEL_PER_CHUNK],
+            std::vector<Vertex> vertices[MODEL_PER_CHUNK]) {
   glm::ivec3 inter = glm::ivec3(0);
   std::vector<glm::ivec2> interval_dimension[3] = {{}};
   for (unsigned int model_id = 0; model_id < MODEL_PER_CHUNK; model_id++) {
-    if (chunk->dirty[model_id] == false) continue;
-    std::vector<Vertex> vertices;
+    if (dirty[model_id] == false) continue;
     for (int y = model_id * MODEL_HEIGHT; y < ((model_id + 1) * MODEL_HEIGHT);
          y++) {
       for (int x = 0; x < CHUNK_SIZE; x++) {
         Block current_block = {};
         for (int z = 0; z < CHUNK_SIZE; z++) {
-          Block front_block = get_block(chunk->data, {x, y, z});
+          Block front_block = get_block(data, {x, y, z});
           if (front_block.material != Material::Air &&
               !is_fill(interval_dimension, {x, y, z})) {
             Block b = front_block.material != Material::Air ? front_block
                                                             : current_block;
-            inter = get_interval(chunk->data, glm::ivec3(x, y, z), b);
+            inter = get_interval(data, glm::ivec3(x, y, z), b);
             interval_dimension[0].push_back({x, x + inter.x});
             interval_dimension[1].push_back({y, y + inter.y});
             interval_dimension[2].push_back({z, z + inter.z});
-            auto cube = get_scaled_cube(chunk, b, inter, {x, y, z});
-            vertices.insert(vertices.begin(), cube.begin(), cube.end());
+            auto cube = get_scaled_cube(b, inter, {x, y, z});
+            vertices[model_id].insert(vertices[model_id].begin(), cube.begin(),
+                                      cube.end());
             current_block = front_block;
           }
         }
       }
     }
-    chunk->dirty[model_id] = false;
-    total_vertices += vertices.size();
-    if (render_attrib.vaos[model_id] == nullptr) {
-      render_attrib.vaos[model_id] = new VAO(vertices);
-    } else {
-      render_attrib.vaos[model_id]->update(vertices);
-    }
-    // std::cout << "Mesher: " << total_vertices << " vertices" << std::endl;
   }
 }
 void culling(Chunk *chunk, RenderAttrib &render_attrib) {
@@ -293,39 +282,39 @@ void culling(Chunk *chunk, RenderAttrib &render_attrib) {
             Block b = front_block.material != Material::Air ? front_block
                                                             : current_block;
             auto quad =
-                getFace(chunk, b, {x, y, z - 1}, BlockSide::Front, glm::vec3(1.0f));
+                getFace(b, {x, y, z - 1}, BlockSide::Front, glm::vec3(1.0f));
             vertices.insert(vertices.end(), quad.begin(), quad.end());
             current_block = front_block;
           }
           if (z == CHUNK_SIZE - 1 && current_block.material != Material::Air) {
-            auto quad = getFace(chunk, current_block, {x, y, z},
+            auto quad = getFace(current_block, {x, y, z},
                                 BlockSide::Back, glm::vec3(1.0f));
             vertices.insert(vertices.end(), quad.begin(), quad.end());
           }
           if (x == 0 && current_block.material != Material::Air) {
-            auto quad = getFace(chunk, current_block, {x, y, z},
+            auto quad = getFace(current_block, {x, y, z},
                                 BlockSide::Right, glm::vec3(1.0f));
             vertices.insert(vertices.end(), quad.begin(), quad.end());
           }
           if (x == CHUNK_SIZE - 1 && current_block.material != Material::Air) {
-            auto quad = getFace(chunk, current_block, {x, y, z},
+            auto quad = getFace(current_block, {x, y, z},
                                 BlockSide::Left, glm::vec3(1.0f));
             vertices.insert(vertices.end(), quad.begin(), quad.end());
           }
           if (y == 0 && current_block.material != Material::Air) {
-            auto quad = getFace(chunk, current_block, {x, y, z},
+            auto quad = getFace(current_block, {x, y, z},
                                 BlockSide::Bottom, glm::vec3(1.0f));
             vertices.insert(vertices.end(), quad.begin(), quad.end());
           }
           if (y == CHUNK_HEIGHT - 1 &&
               current_block.material != Material::Air) {
-            auto quad = getFace(chunk, current_block, {x, y, z}, BlockSide::Up,
+            auto quad = getFace(current_block, {x, y, z}, BlockSide::Up,
                                 glm::vec3(1.0f));
             vertices.insert(vertices.end(), quad.begin(), quad.end());
           }
           if (y == ((model_id + 1) * MODEL_HEIGHT) - 1 &&
               current_block.material != Material::Air) {
-            auto quad = getFace(chunk, current_block, {x, y, z}, BlockSide::Up,
+            auto quad = getFace(current_block, {x, y, z}, BlockSide::Up,
                                 glm::vec3(1.0f));
             vertices.insert(vertices.end(), quad.begin(), quad.end());
           }
@@ -337,7 +326,7 @@ void culling(Chunk *chunk, RenderAttrib &render_attrib) {
               Block b = get_block(chunk->data, positions[f]);
               if (b.material != Material::Air) {
                 auto quad =
-                    getFace(chunk, b, positions[f], sides[f], glm::vec3(1.0f));
+                    getFace(b, positions[f], sides[f], glm::vec3(1.0f));
                 vertices.insert(vertices.end(), quad.begin(), quad.end());
               }
             }
@@ -393,8 +382,16 @@ void get_aabb(Block *data, glm::vec3 &aabb_center, glm::vec3 &aabb_halfsize,
 }
 
 inline void set_block(Block *data, Block block, glm::ivec3 index) {
-  data[index.y * CHUNK_SIZE * CHUNK_SIZE + index.x * CHUNK_SIZE + index.z] =
-      block;
+  data[BlockLayout::index(index)] = block;
+}
+
+Block get_block(const ChunkSections &sections, glm::ivec3 index) {
+  if (index.x < 0 || index.x >= CHUNK_SIZE || index.y < 0 || index.y >= 256 ||
+      index.z < 0 || index.z >= CHUNK_SIZE) {
+    Block block = {};
+    return (block);
+  }
+  return (sections.get(BlockLayout::index(index)));
 }
 
 inline Block get_block(Block *data, glm::ivec3 index) {
@@ -403,7 +400,6 @@ inline Block get_block(Block *data, glm::ivec3 index) {
     Block block = {};
     return (block);
   }
-  return (
-      data[index.y * CHUNK_SIZE * CHUNK_SIZE + index.x * CHUNK_SIZE + index.z]);
+  return (data[BlockLayout::index(index)]);
 }
 }  // namespace mesher
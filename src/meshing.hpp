@@ -3,17 +3,22 @@
 #include "chunk.hpp"
 #include "ft_vox.hpp"
 #include "renderer.hpp"
+#include "section.hpp"
 
 class Chunk;
 
 namespace mesher {
-void greedy(Chunk *chunk, RenderAttrib &render_attrib);
+// Builds the vertices of every dirty section, no GL calls: safe to run off
+// the render thread on a copy of the chunk blocks
+void greedy(Block *data, const bool dirty[MODEL_PER_CHUNK],
+            std::vector<Vertex> vertices[MODEL_PER_CHUNK]);
 void culling(Chunk *chunk, RenderAttrib &render_attrib);
 void get_aabb(Block *data, glm::vec3 &aabb_center, glm::vec3 &aabb_halfsize,
               const glm::vec3 chunk_pos);
 glm::ivec3 get_interval(Block *data, glm::ivec3 pos, Block current_block);
 void set_block(Block *data, Block block, glm::ivec3 index);
 Block get_block(Block *data, glm::ivec3 index);
+Block get_block(const ChunkSections &sections, glm::ivec3 index);
 glm::vec3 get_normal(enum BlockSide side);
 glm::vec3 get_euler_rotation(enum BlockSide side);
 const std::vector<glm::vec3> getFace(glm::ivec3, enum BlockSide side);
@@ -0,0 +1,73 @@
+#include "pool.hpp"
+
+BlockBuffer::BlockBuffer(void) : _pool(nullptr), _data(nullptr) {}
+
+BlockBuffer::BlockBuffer(BlockPool* pool, Block* data)
+    : _pool(pool), _data(data) {}
+
+BlockBuffer::BlockBuffer(BlockBuffer&& src)
+    : _pool(src._pool), _data(src._data) {
+  src._pool = nullptr;
+  src._data = nullptr;
+}
+
+BlockBuffer::~BlockBuffer(void) { reset(); }
+
+BlockBuffer& BlockBuffer::operator=(BlockBuffer&& rhs) {
+  if (this != &rhs) {
+    reset();
+    this->_pool = rhs._pool;
+    this->_data = rhs._data;
+    rhs._pool = nullptr;
+    rhs._data = nullptr;
+  }
+  return (*this);
+}
+
+Block* BlockBuffer::get() const { return (_data); }
+
+bool BlockBuffer::empty() const { return (_data == nullptr); }
+
+void BlockBuffer::reset() {
+  if (_data != nullptr) {
+    _pool->release(_data);
+    _pool = nullptr;
+    _data = nullptr;
+  }
+}
+
+BlockPool::BlockPool(void) {}
+
+BlockPool::~BlockPool(void) {}
+
+BlockBuffer BlockPool::acquire() {
+  std::lock_guard<std::mutex> lock(_mutex);
+  if (_free.empty()) {
+    Block* slab = new Block[BLOCK_POOL_SLAB * CHUNK_BLOCKS];
+    _slabs.push_back(std::unique_ptr<Block[]>(slab));
+    for (int i = BLOCK_POOL_SLAB - 1; i >= 0; i--) {
+      _free.push_back(slab + i * CHUNK_BLOCKS);
+    }
+  }
+  Block* data = _free.back();
+  _free.pop_back();
+  return (BlockBuffer(this, data));
+}
+
+void BlockPool::release(Block* data) {
+  std::lock_guard<std::mutex> lock(_mutex);
+  _free.push_back(data);
+}
+
+PoolStats BlockPool::getStats() {
+  std::lock_guard<std::mutex> lock(_mutex);
+  PoolStats stats;
+  stats.buffers = _slabs.size() * BLOCK_POOL_SLAB;
+  stats.in_use = stats.buffers - _free.size();
+  return (stats);
+}
+
+BlockPool& getBlockPool() {
+  static BlockPool pool;
+  return (pool);
+}
@@ -0,0 +1,66 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "ft_vox.hpp"
+
+#define BLOCK_POOL_SLAB 32  // Chunk buffers allocated at once (2 MB)
+
+class BlockPool;
+
+// Owns one chunk worth of blocks (CHUNK_BLOCKS) taken from a BlockPool,
+// given back when the handle is reset or destroyed. Move only: a buffer
+// always has a single owner (chunk, job, I/O request...).
+class BlockBuffer {
+ public:
+  BlockBuffer(void);  // Empty
+  BlockBuffer(BlockBuffer&& src);
+  ~BlockBuffer(void);
+  BlockBuffer& operator=(BlockBuffer&& rhs);
+
+  Block* get() const;
+  bool empty() const;
+  void reset();
+  Block& operator[](size_t index) const { return (_data[index]); };
+
+ private:
+  friend class BlockPool;
+  BlockBuffer(BlockBuffer const& src);
+  BlockBuffer& operator=(BlockBuffer const& rhs);
+  BlockBuffer(BlockPool* pool, Block* data);
+
+  BlockPool* _pool;
+  Block* _data;
+};
+
+struct PoolStats {
+  size_t buffers;  // Allocated, in use or free
+  size_t in_use;
+};
+
+// Fixed size chunk buffers carved from slabs, recycled through a free list.
+// Slabs are never released, the pool stays at its peak size.
+// Thread safe, buffers are acquired and released by the jobs and the I/O
+// thread as well.
+class BlockPool {
+ public:
+  BlockPool(void);
+  ~BlockPool(void);
+
+  BlockBuffer acquire();  // Content is undefined
+  PoolStats getStats();
+
+ private:
+  friend class BlockBuffer;
+  BlockPool(BlockPool const& src);
+  BlockPool& operator=(BlockPool const& rhs);
+  void release(Block* data);
+
+  std::mutex _mutex;
+  std::vector<std::unique_ptr<Block[]> > _slabs;
+  std::vector<Block*> _free;
+};
+
+// Shared by every chunk buffer owner
+BlockPool& getBlockPool();
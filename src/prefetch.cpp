@@ -0,0 +1,23 @@
+#include "prefetch.hpp"
+
+glm::ivec2 prefetch_focus(enum PrefetchPolicy policy, glm::vec3 pos,
+                          glm::vec3 velocity, glm::vec3 view_dir,
+                          int render_distance) {
+  glm::vec2 ahead(0.0f);
+  if (policy == PrefetchPolicy::Predictive) {
+    ahead = glm::vec2(velocity.x, velocity.z) * PREFETCH_HORIZON;
+    glm::vec2 view(view_dir.x, view_dir.z);
+    if (glm::length(view) > 0.0f) {
+      ahead += glm::normalize(view) *
+               static_cast<float>(PREFETCH_VIEW_AHEAD * CHUNK_SIZE);
+    }
+    // Chunks around the player still come first
+    float max_ahead = render_distance * CHUNK_SIZE * 0.5f;
+    if (glm::length(ahead) > max_ahead) {
+      ahead = glm::normalize(ahead) * max_ahead;
+    }
+  }
+  glm::vec2 focus = glm::vec2(pos.x, pos.z) + ahead;
+  return (glm::ivec2((static_cast<int>(focus.x) >> 4) * CHUNK_SIZE,
+                     (static_cast<int>(focus.y) >> 4) * CHUNK_SIZE));
+}
@@ -0,0 +1,16 @@
+#pragma once
+#define GLM_ENABLE_EXPERIMENTAL
+#include <glm/glm.hpp>
+#include "ft_vox.hpp"
+
+// What the generate and mesh queues are centred on
+enum class PrefetchPolicy {
+  Distance,   // The player chunk
+  Predictive  // Where velocity and view direction take the player next
+};
+
+// Chunk the queues are centred on. velocity is in blocks per second,
+// smoothed by the caller, render_distance in chunks.
+glm::ivec2 prefetch_focus(enum PrefetchPolicy policy, glm::vec3 pos,
+                          glm::vec3 velocity, glm::vec3 view_dir,
+                          int render_distance);
@@ -0,0 +1,91 @@
+#include "queue.hpp"
+
+ChunkQueue::ChunkQueue(void) : _center(0), _stamp(0) {}
+
+ChunkQueue::ChunkQueue(ChunkQueue const& src) { *this = src; }
+
+ChunkQueue::~ChunkQueue(void) {}
+
+ChunkQueue& ChunkQueue::operator=(ChunkQueue const& rhs) {
+  if (this != &rhs) {
+    this->_heap = rhs._heap;
+    this->_live = rhs._live;
+    this->_center = rhs._center;
+    this->_stamp = rhs._stamp;
+  }
+  return (*this);
+}
+
+int64_t ChunkQueue::distanceKey(glm::ivec2 pos) const {
+  int64_t dx = pos.x - _center.x;
+  int64_t dz = pos.y - _center.y;
+  return (dx * dx + dz * dz);
+}
+
+void ChunkQueue::push(glm::ivec2 pos) {
+  auto emplace_res = _live.emplace(pos, _stamp);
+  if (emplace_res.second == false) {
+    return;
+  }
+  Entry entry = {distanceKey(pos), pos, _stamp++};
+  _heap.push_back(entry);
+  std::push_heap(_heap.begin(), _heap.end(), EntryCompare());
+}
+
+bool ChunkQueue::pop(glm::ivec2& pos) {
+  while (_heap.empty() == false) {
+    std::pop_heap(_heap.begin(), _heap.end(), EntryCompare());
+    Entry entry = _heap.back();
+    _heap.pop_back();
+    auto live_it = _live.find(entry.pos);
+    if (live_it != _live.end() && live_it->second == entry.stamp) {
+      _live.erase(live_it);
+      pos = entry.pos;
+      return (true);
+    }
+  }
+  return (false);
+}
+
+void ChunkQueue::erase(glm::ivec2 pos) {
+  _live.erase(pos);
+  if (_heap.size() > 2 * _live.size() + 64) {
+    rebuild();
+  }
+}
+
+void ChunkQueue::clear() {
+  _heap.clear();
+  _live.clear();
+}
+
+void ChunkQueue::setCenter(glm::ivec2 center) {
+  if (center == _center) {
+    return;
+  }
+  _center = center;
+  rebuild();
+}
+
+// Drops tombstones and recomputes every key, O(n)
+void ChunkQueue::rebuild() {
+  size_t live = 0;
+  for (size_t i = 0; i < _heap.size(); i++) {
+    auto live_it = _live.find(_heap[i].pos);
+    if (live_it != _live.end() && live_it->second == _heap[i].stamp) {
+      _heap[live] = _heap[i];
+      _heap[live].key = distanceKey(_heap[i].pos);
+      live++;
+    }
+  }
+  _heap.resize(live);
+  std::make_heap(_heap.begin(), _heap.end(), EntryCompare());
+}
+
+bool ChunkQueue::contains(glm::ivec2 pos) const {
+  return (_live.find(pos) != _live.end());
+}
+
+size_t ChunkQueue::size() const { return (_live.size()); }
+
+bool ChunkQueue::empty() const { return (_live.empty()); }
@@ -0,0 +1,48 @@
+#pragma once
+#define GLM_ENABLE_EXPERIMENTAL
+#include <algorithm>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <unordered_map>
+#include <vector>
+#include "ft_vox.hpp"
+
+// Set of chunk positions popped nearest first to a center (the player
+// chunk). Keys are only recomputed when the center moves to another chunk.
+// erase() just forgets the position, its heap entry is skipped once it
+// surfaces (tombstone) and the heap is rebuilt when they pile up.
+class ChunkQueue {
+ public:
+  ChunkQueue(void);
+  ChunkQueue(ChunkQueue const& src);
+  ~ChunkQueue(void);
+  ChunkQueue& operator=(ChunkQueue const& rhs);
+
+  void push(glm::ivec2 pos);  // No-op if already queued
+  bool pop(glm::ivec2& pos);
+  void erase(glm::ivec2 pos);
+  void clear();
+  void setCenter(glm::ivec2 center);
+  bool contains(glm::ivec2 pos) const;
+  size_t size() const;
+  bool empty() const;
+
+ private:
+  struct Entry {
+    int64_t key;  // Squared distance to _center
+    glm::ivec2 pos;
+    uint32_t stamp;  // Stale unless it matches _live[pos]
+  };
+  struct EntryCompare {
+    bool operator()(const Entry& a, const Entry& b) const {
+      return (a.key > b.key);
+    }
+  };
+  int64_t distanceKey(glm::ivec2 pos) const;
+  void rebuild();
+
+  std::vector<Entry> _heap;
+  std::unordered_map<glm::ivec2, uint32_t, ivec2Comparator> _live;
+  glm::ivec2 _center;
+  uint32_t _stamp;
+};
@@ -0,0 +1,268 @@
+#include "raycast.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <limits>
+#include <memory>
+#include <mutex>
+
+ChunkSnapshot::ChunkSnapshot(void) {}
+
+ChunkSnapshot::~ChunkSnapshot(void) {}
+
+void ChunkSnapshot::add(glm::ivec2 pos, const ChunkSections& sections) {
+  _chunks[pos] = &sections;
+}
+
+void ChunkSnapshot::clear() { _chunks.clear(); }
+
+const ChunkSections* ChunkSnapshot::find(glm::ivec2 pos) const {
+  auto it = _chunks.find(pos);
+  return (it != _chunks.end() ? it->second : nullptr);
+}
+
+size_t ChunkSnapshot::size() const { return (_chunks.size()); }
+
+namespace raycast {
+// Axis stepped next, on equal times z goes before y and y before x
+inline int earliest(float tx, float ty, float tz) {
+  if (tx < ty) {
+    return (tx < tz ? 0 : 2);
+  }
+  return (ty < tz ? 1 : 2);
+}
+
+Traversal::Traversal(const Ray& ray)
+    : pos(glm::floor(ray.pos)),
+      count(0),
+      axis(RayAxis::None),
+      max_dist(ray.max_dist) {
+  // http://www.cse.chalmers.se/edu/year/2011/course/TDA361/grid.pdf
+  for (int i = 0; i < 3; i++) {
+    step[i] = ray.dir[i] < 0.0f ? -1 : 1;
+    if (ray.dir[i] == 0.0f) {
+      first[i] = std::numeric_limits<float>::infinity();
+      delta[i] = 0.0f;
+      continue;
+    }
+    // Same as the former intbound(): on a voxel boundary going down, the
+    // first step is at t = 0 and enters the voxel below straight away
+    float p = ray.pos[i];
+    delta[i] = 1.0f / std::fabs(ray.dir[i]);
+    first[i] = (ray.dir[i] > 0.0f ? std::ceil(p) - p : p - std::floor(p)) /
+               std::fabs(ray.dir[i]);
+  }
+}
+
+bool Traversal::next() {
+  int i = earliest(time(0, count.x), time(1, count.y), time(2, count.z));
+  if (time(i, count[i]) > max_dist) {
+    return (false);
+  }
+  pos[i] += step[i];
+  count[i]++;
+  axis = static_cast<RayAxis>(i + 1);
+  return (true);
+}
+
+bool Traversal::leave(glm::ivec3 min, glm::ivec3 max) {
+  // Steps each axis needs to cross the box, and when the last one happens
+  int crossing[3];
+  float exit_time[3];
+  for (int i = 0; i < 3; i++) {
+    crossing[i] = step[i] > 0 ? max[i] - pos[i] : pos[i] - min[i] + 1;
+    exit_time[i] = time(i, count[i] + crossing[i] - 1);
+  }
+  int exit = earliest(exit_time[0], exit_time[1], exit_time[2]);
+  bool ends = exit_time[exit] > max_dist;
+  for (int i = 0; i < 3; i++) {
+    int steps;
+    if (ends) {
+      steps = stepsBefore(i, max_dist, -1, crossing[i]);
+    } else if (i == exit) {
+      steps = crossing[i];
+    } else {
+      steps = stepsBefore(i, exit_time[exit], exit, crossing[i]);
+    }
+    pos[i] += steps * step[i];
+    count[i] += steps;
+  }
+  if (ends) {
+    return (false);
+  }
+  axis = static_cast<RayAxis>(exit + 1);
+  return (true);
+}
+
+// Pending steps of an axis that come before time t (and before tie_axis
+// on equal times, see earliest()), at most limit
+int Traversal::stepsBefore(int axis, float t, int tie_axis, int limit) const {
+  if (delta[axis] == 0.0f) {
+    return (0);
+  }
+  auto before = [&](int steps) {
+    float step_time = time(axis, count[axis] + steps);
+    return (step_time < t || (step_time == t && axis > tie_axis));
+  };
+  // Estimated, then settled with the exact step times
+  float estimate = (t - first[axis]) / delta[axis] - count[axis];
+  int steps = static_cast<int>(
+      std::max(0.0f, std::min(estimate, static_cast<float>(limit))));
+  while (steps > 0 && !before(steps - 1)) {
+    steps--;
+  }
+  while (steps < limit && before(steps)) {
+    steps++;
+  }
+  return (steps);
+}
+
+enum BlockSide get_face(enum RayAxis axis, glm::ivec3 step) {
+  if (axis == RayAxis::X) {
+    return (step.x == -1 ? BlockSide::Left : BlockSide::Right);
+  } else if (axis == RayAxis::Y) {
+    return (step.y == 1 ? BlockSide::Bottom : BlockSide::Up);
+  }
+  return (step.z == 1 ? BlockSide::Back : BlockSide::Front);
+}
+
+bool get_air_box(const ChunkSections* chunk, glm::ivec3 local,
+                 glm::ivec3& min, glm::ivec3& max) {
+  if (chunk == nullptr) {
+    min = glm::ivec3(0);
+    max = glm::ivec3(CHUNK_SIZE, CHUNK_HEIGHT, CHUNK_SIZE);
+    return (true);
+  }
+  int id = local.y / MODEL_HEIGHT;
+  if (chunk->getBlockCount(id) == 0) {
+    int low = id;
+    int high = id + 1;
+    while (low > 0 && chunk->getBlockCount(low - 1) == 0) {
+      low--;
+    }
+    while (high < MODEL_PER_CHUNK && chunk->getBlockCount(high) == 0) {
+      high++;
+    }
+    min = glm::ivec3(0, low * MODEL_HEIGHT, 0);
+    max = glm::ivec3(CHUNK_SIZE, high * MODEL_HEIGHT, CHUNK_SIZE);
+    return (true);
+  }
+  int height = chunk->getHeight(local.x, local.z);
+  if (local.y > height) {
+    min = glm::ivec3(local.x, height + 1, local.z);
+    max = glm::ivec3(local.x + 1, CHUNK_HEIGHT, local.z + 1);
+    return (true);
+  }
+  return (false);
+}
+
+void castRays(const ChunkSnapshot& snapshot, const std::vector<Ray>& rays,
+              std::vector<HitInfo>& hits) {
+  auto lookup = [&snapshot](glm::ivec2 pos) { return (snapshot.find(pos)); };
+  hits.resize(rays.size());
+  for (size_t i = 0; i < rays.size(); i++) {
+    hits[i] = castRay(rays[i], lookup);
+  }
+}
+
+// Shared by the caller and the jobs of a parallel castRays. Jobs that only
+// start once every task is done still hold it, but never claim a task and
+// so never touch the caller's rays and hits.
+struct RayBatch {
+  const ChunkSnapshot* snapshot;
+  const std::vector<Ray>* rays;
+  std::vector<HitInfo>* hits;
+  std::vector<uint32_t> order;  // Ray indices grouped by starting chunk
+  size_t task_count;
+  std::atomic<size_t> next_task;
+  std::atomic<size_t> done_tasks;
+  std::mutex mutex;
+  std::condition_variable cv;
+};
+
+// Counting sort of the rays by starting chunk, so a task mostly reads the
+// same few chunks
+void group_rays(const std::vector<Ray>& rays, std::vector<uint32_t>& order) {
+  std::unordered_map<glm::ivec2, uint32_t, ivec2Comparator> groups;
+  std::vector<uint32_t> ray_group(rays.size());
+  std::vector<size_t> group_start;
+  glm::ivec2 last_chunk;
+  for (size_t i = 0; i < rays.size(); i++) {
+    glm::ivec3 pos = glm::floor(rays[i].pos);
+    glm::ivec2 chunk = get_chunk_pos(pos);
+    // Rays often come in runs from the same origin
+    if (i > 0 && chunk == last_chunk) {
+      ray_group[i] = ray_group[i - 1];
+    } else {
+      auto group = groups.find(chunk);
+      if (group == groups.end()) {
+        uint32_t id = static_cast<uint32_t>(group_start.size());
+        group = groups.insert(std::make_pair(chunk, id)).first;
+        group_start.push_back(0);
+      }
+      ray_group[i] = group->second;
+      last_chunk = chunk;
+    }
+    group_start[ray_group[i]]++;
+  }
+  size_t start = 0;
+  for (size_t& group : group_start) {
+    size_t count = group;
+    group = start;
+    start += count;
+  }
+  order.resize(rays.size());
+  for (size_t i = 0; i < rays.size(); i++) {
+    order[group_start[ray_group[i]]++] = static_cast<uint32_t>(i);
+  }
+}
+
+// Claims tasks until there are none left
+void run_tasks(RayBatch& batch) {
+  auto lookup = [&batch](glm::ivec2 pos) {
+    return (batch.snapshot->find(pos));
+  };
+  size_t task;
+  while ((task = batch.next_task++) < batch.task_count) {
+    size_t end =
+        std::min(batch.order.size(), (task + 1) * RAYCAST_TASK_RAYS);
+    for (size_t i = task * RAYCAST_TASK_RAYS; i < end; i++) {
+      uint32_t ray = batch.order[i];
+      (*batch.hits)[ray] = castRay((*batch.rays)[ray], lookup);
+    }
+    if (++batch.done_tasks == batch.task_count) {
+      std::lock_guard<std::mutex> lock(batch.mutex);
+      batch.cv.notify_all();
+    }
+  }
+}
+
+void castRays(const ChunkSnapshot& snapshot, const std::vector<Ray>& rays,
+              std::vector<HitInfo>& hits, JobSystem& jobs) {
+  if (rays.size() <= RAYCAST_TASK_RAYS) {
+    castRays(snapshot, rays, hits);
+    return;
+  }
+  std::shared_ptr<RayBatch> batch = std::make_shared<RayBatch>();
+  batch->snapshot = &snapshot;
+  batch->rays = &rays;
+  batch->hits = &hits;
+  group_rays(rays, batch->order);
+  batch->task_count =
+      (rays.size() + RAYCAST_TASK_RAYS - 1) / RAYCAST_TASK_RAYS;
+  batch->next_task = 0;
+  batch->done_tasks = 0;
+  hits.resize(rays.size());
+  // Workers busy with chunk jobs join late, or not at all
+  size_t helpers =
+      std::min<size_t>(jobs.getThreadCount(), batch->task_count - 1);
+  for (size_t i = 0; i < helpers; i++) {
+    jobs.submit([batch]() { run_tasks(*batch); });
+  }
+  run_tasks(*batch);
+  std::unique_lock<std::mutex> lock(batch->mutex);
+  batch->cv.wait(lock,
+                 [&batch] { return (batch->done_tasks == batch->task_count); });
+}
+}  // namespace raycast
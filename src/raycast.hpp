@@ -0,0 +1,136 @@
+#pragma once
+#include <unordered_map>
+#include <vector>
+#include "ft_vox.hpp"
+#include "jobs.hpp"
+#include "layout.hpp"
+#include "section.hpp"
+
+// Axis of the last voxel step of a ray
+enum class RayAxis : unsigned char { None, X, Y, Z };
+
+struct Ray {
+  glm::vec3 pos;
+  glm::vec3 dir;
+  float max_dist;  // Along dir, in dir lengths
+};
+
+// Read only view of chunks for batches of rays, by chunk position.
+// Only holds pointers: valid until one of the chunks is modified or
+// unloaded. Lookups are safe from any number of threads.
+class ChunkSnapshot {
+ public:
+  ChunkSnapshot(void);
+  ~ChunkSnapshot(void);
+
+  void add(glm::ivec2 pos, const ChunkSections& sections);
+  void clear();
+  const ChunkSections* find(glm::ivec2 pos) const;  // nullptr: air
+  size_t size() const;
+
+ private:
+  ChunkSnapshot(ChunkSnapshot const& src);
+  ChunkSnapshot& operator=(ChunkSnapshot const& rhs);
+
+  std::unordered_map<glm::ivec2, const ChunkSections*, ivec2Comparator>
+      _chunks;
+};
+
+namespace raycast {
+// Voxel traversal (Amanatides & Woo). Step times are kept as
+// first + count * delta rather than accumulated, so leaving a box in one
+// go lands exactly where as many single steps would.
+struct Traversal {
+  glm::ivec3 pos;
+  glm::ivec3 step;
+  glm::vec3 first;   // Time of the first step, infinity if parallel
+  glm::vec3 delta;   // Time between two steps
+  glm::ivec3 count;  // Steps taken on each axis
+  enum RayAxis axis;
+  float max_dist;
+
+  Traversal(const Ray& ray);
+  float time(int axis, int steps) const {
+    return (first[axis] + static_cast<float>(steps) * delta[axis]);
+  };
+  bool next();  // One voxel, false if it is past max_dist
+  // First voxel out of [min, max), false if the ray ends inside: pos is
+  // then the last voxel reached
+  bool leave(glm::ivec3 min, glm::ivec3 max);
+
+ private:
+  int stepsBefore(int axis, float t, int tie_axis, int limit) const;
+};
+
+enum BlockSide get_face(enum RayAxis axis, glm::ivec3 step);
+// Box of known air around local (chunk coordinates) from the section
+// counts and column heights, false if the block itself has to be read
+bool get_air_box(const ChunkSections* chunk, glm::ivec3 local,
+                 glm::ivec3& min, glm::ivec3& max);
+
+// Rounded towards -infinity, unlike /
+inline int floor_div(int value, int divisor) {
+  return (value / divisor - (value % divisor < 0 ? 1 : 0));
+}
+
+// Position of the chunk holding a block
+inline glm::ivec2 get_chunk_pos(glm::ivec3 pos) {
+  return (glm::ivec2(floor_div(pos.x, CHUNK_SIZE) * CHUNK_SIZE,
+                     floor_div(pos.z, CHUNK_SIZE) * CHUNK_SIZE));
+}
+
+// Lookup(glm::ivec2 chunk_pos) returns the const ChunkSections* of a
+// chunk, nullptr reads as air. The origin voxel is never a hit.
+// Runs of empty sections and missing chunks are crossed in a single step,
+// columns above the terrain are stepped without reading blocks.
+template <class Lookup>
+struct HitInfo castRay(const Ray& ray, Lookup lookup) {
+  Traversal traversal(ray);
+  struct HitInfo info = {};
+  glm::ivec2 chunk_pos = get_chunk_pos(traversal.pos);
+  const ChunkSections* chunk = lookup(chunk_pos);
+  bool origin = true;
+  while (traversal.pos.y >= 0 && traversal.pos.y < CHUNK_HEIGHT) {
+    glm::ivec2 next_pos = get_chunk_pos(traversal.pos);
+    if (next_pos != chunk_pos) {
+      chunk_pos = next_pos;
+      chunk = lookup(chunk_pos);
+    }
+    glm::ivec3 offset(chunk_pos.x, 0, chunk_pos.y);
+    glm::ivec3 local = traversal.pos - offset;
+    glm::ivec3 min;
+    glm::ivec3 max;
+    bool moved;
+    if (origin) {
+      moved = traversal.next();
+    } else if (get_air_box(chunk, local, min, max)) {
+      // Most rays leave a column within a voxel or two
+      moved = max.x - min.x == 1 ? traversal.next()
+                                 : traversal.leave(min + offset, max + offset);
+    } else if (chunk->get(BlockLayout::index(local)).material !=
+               Material::Air) {
+      info.hit = true;
+      info.side = get_face(traversal.axis, traversal.step);
+      info.model = glm::translate(glm::vec3(offset));
+      return (info);
+    } else {
+      moved = traversal.next();
+    }
+    info.pos = traversal.pos;
+    if (moved == false) {
+      break;
+    }
+    origin = false;
+  }
+  return (info);
+}
+
+// hits[i] is the hit of rays[i]
+void castRays(const ChunkSnapshot& snapshot, const std::vector<Ray>& rays,
+              std::vector<HitInfo>& hits);
+// Same, spread over the workers of jobs in tasks of RAYCAST_TASK_RAYS rays
+// starting in the same chunk. The calling thread runs tasks as well and
+// returns once every ray is cast, the snapshot must not change until then.
+void castRays(const ChunkSnapshot& snapshot, const std::vector<Ray>& rays,
+              std::vector<HitInfo>& hits, JobSystem& jobs);
+}  // namespace raycast
@@ -0,0 +1,488 @@
+#include "region.hpp"
+
+RegionWorker::RegionWorker(void)
+    : _in_flight(0), _running(true), _region_uses(0) {
+  _thread = std::thread(&RegionWorker::run, this);
+}
+
+RegionWorker::~RegionWorker(void) {
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _running = false;
+  }
+  _cv.notify_one();
+  // Remaining requests (ie. saves pushed on shutdown) are drained first
+  _thread.join();
+  for (auto& region : _regions) {
+    closeRegion(region.second);
+  }
+}
+
+void RegionWorker::push(RegionRequest request) {
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _requests.push_back(std::move(request));
+  }
+  _cv.notify_one();
+}
+
+bool RegionWorker::poll(RegionResult& result) {
+  std::lock_guard<std::mutex> lock(_mutex);
+  if (_results.empty()) {
+    return (false);
+  }
+  result = std::move(_results.front());
+  _results.pop_front();
+  return (true);
+}
+
+CodecStats RegionWorker::getCodecStats(CodecId id) {
+  std::lock_guard<std::mutex> lock(_mutex);
+  return (_stats[static_cast<int>(id)]);
+}
+
+size_t RegionWorker::pending() {
+  std::lock_guard<std::mutex> lock(_mutex);
+  return (_requests.size() + _in_flight + _results.size());
+}
+
+void RegionWorker::run() {
+  while (1) {
+    RegionRequest request;
+    {
+      std::unique_lock<std::mutex> lock(_mutex);
+      _cv.wait(lock, [this] { return (!_running || !_requests.empty()); });
+      if (_requests.empty()) {
+        return;
+      }
+      request = std::move(_requests.front());
+      _requests.pop_front();
+      _in_flight++;
+    }
+    if (request.type == RegionRequestType::Load) {
+      RegionResult result;
+      loadRegion(request, result);
+      std::lock_guard<std::mutex> lock(_mutex);
+      _results.push_back(std::move(result));
+      _in_flight--;
+      continue;
+    }
+    switch (request.type) {
+      case RegionRequestType::Save:
+        saveRegion(request);
+        break;
+      case RegionRequestType::Patch:
+        patchRegion(request);
+        break;
+      case RegionRequestType::JournalAppend:
+        if (io::appendJournal(request.filename, request.journal) == false) {
+          std::cerr << request.filename << ": journal append failed"
+                    << std::endl;
+        }
+        break;
+      case RegionRequestType::JournalTruncate:
+        syncRegions();
+        io::truncateFile(request.filename);
+        break;
+      default:
+        break;
+    }
+    std::lock_guard<std::mutex> lock(_mutex);
+    _in_flight--;
+  }
+}
+
+inline unsigned int read_be(const unsigned char* src, int bytes) {
+  unsigned int value = 0;
+  for (int i = 0; i < bytes; i++) {
+    value = (value << 8) | src[i];
+  }
+  return (value);
+}
+
+inline void write_be(unsigned char* dest, unsigned int value, int bytes) {
+  for (int i = bytes - 1; i >= 0; i--) {
+    dest[i] = value & 0xff;
+    value >>= 8;
+  }
+}
+
+inline void write_entry(unsigned char* dest, const RegionEntry& entry) {
+  write_be(dest, entry.offset, 4);
+  write_be(dest + 4, entry.size, 3);
+  dest[7] = static_cast<unsigned char>(entry.codec);
+}
+
+// Region files hold blocks in FileLayout
+inline size_t encode_blocks(const ChunkCodec& codec, const Block* data,
+                           unsigned char* dest) {
+  if (file_layout_matches()) {
+    return (codec.encode(data, dest));
+  }
+  BlockBuffer file_order = getBlockPool().acquire();
+  relayout<BlockLayout, FileLayout>(data, file_order.get());
+  return (codec.encode(file_order.get(), dest));
+}
+
+RegionFile* RegionWorker::openRegion(const std::string& filename) {
+  auto region_it = _regions.find(filename);
+  if (region_it != _regions.end()) {
+    region_it->second.last_use = ++_region_uses;
+    return (&region_it->second);
+  }
+  if (_regions.size() >= REGION_OPEN_FILES) {
+    auto oldest = _regions.begin();
+    for (auto it = _regions.begin(); it != _regions.end(); it++) {
+      if (it->second.last_use < oldest->second.last_use) {
+        oldest = it;
+      }
+    }
+    closeRegion(oldest->second);
+    _regions.erase(oldest);
+  }
+  RegionFile& region = _regions[filename];
+  region.filename = filename;
+  region.last_use = ++_region_uses;
+  // Never written yet, created on first save
+  if (io::mapFile(filename, region.mapping) == false) {
+    return (&region);
+  }
+  const unsigned char* data = region.mapping.data;
+  region.size = region.mapping.size;
+  if (region.size >= REGION_HEADER_SIZE &&
+      std::memcmp(data, REGION_MAGIC, 4) == 0) {
+    for (int i = 0; i < CHUNK_PER_REGION; i++) {
+      const unsigned char* src = data + 4 + i * REGION_ENTRY_SIZE;
+      RegionEntry& entry = region.entries[i];
+      entry.offset = read_be(src, 4);
+      entry.size = read_be(src + 4, 3);
+      entry.codec = static_cast<CodecId>(src[7]);
+      // Torn append, the chunk is lost
+      if (static_cast<size_t>(entry.offset) + entry.size > region.size) {
+        entry = RegionEntry();
+      }
+      region.live_bytes += entry.size;
+    }
+    region.file = fopen(filename.c_str(), "r+b");
+    return (&region);
+  }
+  // Chunks of older layouts are back to back after the lookup table
+  region.legacy = true;
+  size_t offset = REGION_LOOKUPTABLE_SIZE;
+  CodecId codec_id = CodecId::RLE;
+  if (region.size >= REGION_LEGACY_HEADER_SIZE &&
+      std::memcmp(data, REGION_LEGACY_MAGIC, 3) == 0) {
+    offset = REGION_LEGACY_HEADER_SIZE;
+    codec_id = static_cast<CodecId>(data[3]);
+  }
+  if (region.size < offset) {
+    return (&region);
+  }
+  const unsigned char* lookup = data + offset - REGION_LOOKUPTABLE_SIZE;
+  for (int i = 0; i < CHUNK_PER_REGION; i++) {
+    unsigned int content_size = read_be(lookup + 3 * i, 3);
+    if (region.size < offset + content_size) {
+      break;
+    }
+    if (content_size != 0) {
+      region.entries[i].offset = static_cast<uint32_t>(offset);
+      region.entries[i].size = content_size;
+      region.entries[i].codec = codec_id;
+      region.live_bytes += content_size;
+    }
+    offset += content_size;
+  }
+  return (&region);
+}
+
+void RegionWorker::closeRegion(RegionFile& region) {
+  if (region.file != nullptr) {
+    if (region.unsynced && io::syncFile(region.file) == false) {
+      std::cerr << region.filename << ": sync failed" << std::endl;
+    }
+    fclose(region.file);
+    region.file = nullptr;
+  }
+  io::unmapFile(region.mapping);
+}
+
+// Before the journal is cut, every edit it held has to be on disk
+void RegionWorker::syncRegions() {
+  for (auto& region : _regions) {
+    RegionFile& file = region.second;
+    if (file.unsynced && file.file != nullptr) {
+      if (io::syncFile(file.file) == false) {
+        std::cerr << file.filename << ": sync failed" << std::endl;
+      }
+      file.unsynced = false;
+    }
+  }
+}
+
+const io::MappedFile* RegionWorker::getMapping(RegionFile& region,
+                                               size_t end) {
+  // Appended data lies past the end of older mappings
+  if (region.mapping.size < end) {
+    io::unmapFile(region.mapping);
+    if (io::mapFile(region.filename, region.mapping) == false ||
+        region.mapping.size < end) {
+      return (nullptr);
+    }
+  }
+  return (&region.mapping);
+}
+
+// Writes live chunks back to back under a fresh header, used to compact a
+// region or convert an older layout. The old file is only replaced once
+// the new one is complete.
+bool RegionWorker::rewriteRegion(RegionFile& region) {
+  std::string tmp_filename = region.filename + ".tmp";
+  FILE* file = fopen(tmp_filename.c_str(), "wb");
+  if (file == NULL) {
+    return (false);
+  }
+  unsigned char header[REGION_HEADER_SIZE] = {0};
+  std::memcpy(header, REGION_MAGIC, 4);
+  RegionEntry entries[CHUNK_PER_REGION];
+  const io::MappedFile* mapping = getMapping(region, region.size);
+  size_t offset = REGION_HEADER_SIZE;
+  fseek(file, REGION_HEADER_SIZE, SEEK_SET);
+  for (int i = 0; i < CHUNK_PER_REGION; i++) {
+    const RegionEntry& entry = region.entries[i];
+    if (entry.size != 0 && mapping != nullptr) {
+      fwrite(mapping->data + entry.offset, entry.size, 1, file);
+      entries[i].offset = static_cast<uint32_t>(offset);
+      entries[i].size = entry.size;
+      entries[i].codec = entry.codec;
+      offset += entry.size;
+    }
+    write_entry(header + 4 + i * REGION_ENTRY_SIZE, entries[i]);
+  }
+  fseek(file, 0, SEEK_SET);
+  fwrite(header, REGION_HEADER_SIZE, 1, file);
+  // On disk before the rename can be, or a crash could leave a torn file
+  bool written = (ferror(file) == 0) && io::syncFile(file);
+  written = (fclose(file) == 0) && written;
+  if (written == false ||
+      std::rename(tmp_filename.c_str(), region.filename.c_str()) != 0) {
+    std::remove(tmp_filename.c_str());
+    return (false);
+  }
+  if (io::syncDirectory(region.filename) == false) {
+    std::cerr << region.filename << ": directory sync failed" << std::endl;
+  }
+  // The replaced file is gone, nothing of it needs syncing
+  region.unsynced = false;
+  closeRegion(region);
+  region.file = fopen(region.filename.c_str(), "r+b");
+  region.legacy = false;
+  region.size = offset;
+  region.live_bytes = offset - REGION_HEADER_SIZE;
+  for (int i = 0; i < CHUNK_PER_REGION; i++) {
+    region.entries[i] = entries[i];
+  }
+  return (region.file != nullptr);
+}
+
+void RegionWorker::readChunk(RegionFile& region, int index,
+                             ChunkBuffer& chunk) {
+  chunk.generated = false;
+  chunk.edits_complete = true;
+  const RegionEntry& entry = region.entries[index];
+  if (entry.size == 0) {
+    return;
+  }
+  const ChunkCodec* codec = getChunkCodec(entry.codec);
+  if (codec == nullptr && entry.codec != CodecId::Delta) {
+    std::cerr << region.filename << ": unknown codec "
+              << static_cast<int>(entry.codec) << std::endl;
+    return;
+  }
+  const io::MappedFile* mapping =
+      getMapping(region, static_cast<size_t>(entry.offset) + entry.size);
+  if (mapping == nullptr) {
+    return;
+  }
+  // Decode straight from the mapped pages
+  const unsigned char* src = mapping->data + entry.offset;
+  auto start = std::chrono::steady_clock::now();
+  bool decoded = false;
+  if (codec == nullptr) {
+    // Delta: regenerated and patched by the render thread
+    decoded = io::decodeEdits(src, entry.size, chunk.edits);
+    if (decoded == false) {
+      chunk.edits.clear();
+    }
+  } else {
+    chunk.data = getBlockPool().acquire();
+    // Pooled content is undefined, RLE leaves the dropped last run and
+    // anything past a truncated stream untouched: those read as air
+    std::fill(chunk.data.get(), chunk.data.get() + CHUNK_BLOCKS, Block());
+    decoded = codec->decode(src, entry.size, chunk.data.get());
+    if (decoded && !file_layout_matches()) {
+      BlockBuffer file_order = std::move(chunk.data);
+      chunk.data = getBlockPool().acquire();
+      relayout<FileLayout, BlockLayout>(file_order.get(), chunk.data.get());
+    }
+    if (decoded) {
+      chunk.generated = true;
+      chunk.edits_complete = false;
+    } else {
+      chunk.data.reset();
+    }
+  }
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  std::lock_guard<std::mutex> lock(_mutex);
+  CodecStats& stats = _stats[static_cast<int>(entry.codec)];
+  stats.chunks_decoded += decoded ? 1 : 0;
+  stats.decode_time += elapsed.count();
+}
+
+void RegionWorker::loadRegion(const RegionRequest& request,
+                              RegionResult& result) {
+  result.pos = request.pos;
+  result.chunks.resize(request.chunks.size());
+  RegionFile* region = openRegion(request.filename);
+  for (size_t i = 0; i < request.chunks.size(); i++) {
+    ChunkBuffer& chunk = result.chunks[i];
+    chunk.pos = request.chunks[i].pos;
+    glm::ivec2 local = (chunk.pos - request.pos) / CHUNK_SIZE;
+    readChunk(*region, local.x + local.y * REGION_SIZE, chunk);
+  }
+}
+
+size_t RegionWorker::encodeChunk(const ChunkBuffer& chunk,
+                                 enum CodecId codec_id,
+                                 std::vector<unsigned char>& encoded) {
+  const ChunkCodec* codec = getChunkCodec(codec_id);
+  if (codec != nullptr) {
+    if (chunk.generated) {
+      encoded.resize(codec->maxEncodedSize());
+      return (encode_blocks(*codec, chunk.data.get(), encoded.data()));
+    }
+    if (chunk.edits.empty()) {
+      return (0);
+    }
+    // Loaded from deltas but unloaded before generation, rebuild it here
+    BlockBuffer data = getBlockPool().acquire();
+    std::fill(data.get(), data.get() + CHUNK_BLOCKS, Block());
+    std::vector<Biome> biome(CHUNK_SIZE * CHUNK_SIZE);
+    generator::generate_chunk(data.get(), biome.data(),
+                              glm::vec3(chunk.pos.x, 0, chunk.pos.y));
+    for (const auto& edit : chunk.edits) {
+      data[edit_index(edit.first)] = Block(edit.second);
+    }
+    encoded.resize(codec->maxEncodedSize());
+    return (encode_blocks(*codec, data.get(), encoded.data()));
+  }
+  if (chunk.edits_complete) {
+    encoded.resize(io::maxEditsSize(chunk.edits));
+    return (chunk.edits.empty() ? 0
+                                : io::encodeEdits(chunk.edits, encoded.data()));
+  }
+  // Loaded from full blocks: diff against a regenerated chunk
+  BlockBuffer generated = getBlockPool().acquire();
+  std::fill(generated.get(), generated.get() + CHUNK_BLOCKS, Block());
+  std::vector<Biome> biome(CHUNK_SIZE * CHUNK_SIZE);
+  generator::generate_chunk(generated.get(), biome.data(),
+                            glm::vec3(chunk.pos.x, 0, chunk.pos.y));
+  BlockEdits edits;
+  for (int i = 0; i < CHUNK_BLOCKS; i++) {
+    if (generated[i] != chunk.data[i]) {
+      edits[edit_key(i)] = chunk.data[i].material;
+    }
+  }
+  encoded.resize(io::maxEditsSize(edits));
+  return (edits.empty() ? 0 : io::encodeEdits(edits, encoded.data()));
+}
+
+void RegionWorker::saveRegion(const RegionRequest& request) {
+  RegionFile* region = openRegion(request.filename);
+  // First write of this region, or still in an older layout
+  if (region->file == nullptr && rewriteRegion(*region) == false) {
+    std::cerr << request.filename << ": cannot write region" << std::endl;
+    return;
+  }
+  std::vector<unsigned char> encoded;
+  unsigned char entry_bytes[REGION_ENTRY_SIZE];
+  auto start = std::chrono::steady_clock::now();
+  size_t encoded_chunks = 0;
+  size_t encoded_bytes = 0;
+  std::vector<int> indices;
+  std::vector<RegionEntry> written;
+  fseek(region->file, 0, SEEK_END);
+  for (const auto& chunk : request.chunks) {
+    glm::ivec2 local = (chunk.pos - request.pos) / CHUNK_SIZE;
+    size_t content_size = encodeChunk(chunk, request.codec, encoded);
+    RegionEntry entry;
+    entry.size = static_cast<uint32_t>(content_size);
+    entry.codec = request.codec;
+    if (content_size != 0) {
+      entry.offset = static_cast<uint32_t>(region->size);
+      fwrite(encoded.data(), content_size, 1, region->file);
+      region->size += content_size;
+    }
+    indices.push_back(local.x + local.y * REGION_SIZE);
+    written.push_back(entry);
+    // Only chunks written with the codec: under Delta, chunks without
+    // edits write nothing, and block codecs also encode chunks rebuilt
+    // from their edits
+    if (content_size != 0) {
+      encoded_chunks++;
+      encoded_bytes += content_size;
+    }
+  }
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  // Appended data reaches the disk before any entry points to it: a crash
+  // in between leaves dead bytes and the previous versions in place
+  if (io::syncFile(region->file) == false) {
+    std::cerr << request.filename << ": cannot sync region" << std::endl;
+    return;
+  }
+  for (size_t i = 0; i < indices.size(); i++) {
+    RegionEntry& entry = region->entries[indices[i]];
+    region->live_bytes += written[i].size;
+    region->live_bytes -= entry.size;
+    entry = written[i];
+    write_entry(entry_bytes, entry);
+    fseek(region->file, 4 + indices[i] * REGION_ENTRY_SIZE, SEEK_SET);
+    fwrite(entry_bytes, REGION_ENTRY_SIZE, 1, region->file);
+  }
+  // Reads go through the mapping, it has to see every byte written
+  fflush(region->file);
+  region->unsynced = true;
+  size_t dead_bytes = region->size - REGION_HEADER_SIZE - region->live_bytes;
+  if (dead_bytes >= REGION_COMPACT_MIN && dead_bytes > region->live_bytes) {
+    rewriteRegion(*region);
+  }
+  std::lock_guard<std::mutex> lock(_mutex);
+  CodecStats& stats = _stats[static_cast<int>(request.codec)];
+  stats.chunks_encoded += encoded_chunks;
+  stats.bytes_encoded += encoded_bytes;
+  stats.encode_time += elapsed.count();
+}
+
+void RegionWorker::patchRegion(const RegionRequest& request) {
+  RegionFile* region = openRegion(request.filename);
+  RegionRequest save;
+  save.type = RegionRequestType::Save;
+  save.pos = request.pos;
+  save.filename = request.filename;
+  save.codec = request.codec;
+  for (const auto& patch : request.chunks) {
+    glm::ivec2 local = (patch.pos - request.pos) / CHUNK_SIZE;
+    ChunkBuffer chunk;
+    chunk.pos = patch.pos;
+    readChunk(*region, local.x + local.y * REGION_SIZE, chunk);
+    for (const auto& edit : patch.edits) {
+      if (chunk.generated) {
+        chunk.data[edit_index(edit.first)] = Block(edit.second);
+      }
+      chunk.edits[edit.first] = edit.second;
+    }
+    save.chunks.push_back(std::move(chunk));
+  }
+  saveRegion(save);
+}
@@ -0,0 +1,136 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "codec.hpp"
+#include "ft_vox.hpp"
+#include "generator.hpp"
+#include "io.hpp"
+#include "pool.hpp"
+
+// Region file layout:
+//   ["VOXC"][entry table: per chunk offset (4 bytes), size (3 bytes),
+//            codec id (1 byte), big endian]
+//   [encoded chunks, in any order]
+// A chunk is rewritten by appending it, syncing, then updating its entry,
+// the file is compacted once dead bytes outweigh live ones.
+// Older layouts are read as is and converted on their first write:
+//   ["VOX"][codec id][lookup table: 3 bytes big endian size per chunk]
+//   [encoded chunks, back to back in lookup table order]
+// and, before codecs existed, a bare lookup table with RLE chunks.
+#define REGION_MAGIC "VOXC"
+#define REGION_ENTRY_SIZE 8
+#define REGION_HEADER_SIZE (4 + CHUNK_PER_REGION * REGION_ENTRY_SIZE)
+#define REGION_LEGACY_MAGIC "VOX"
+#define REGION_LEGACY_HEADER_SIZE (4 + REGION_LOOKUPTABLE_SIZE)
+#define REGION_OPEN_FILES 32       // Region files kept open by the I/O thread
+#define REGION_COMPACT_MIN 262144  // Dead bytes before compaction is considered
+
+// Decoded chunk exchanged between the render thread and the I/O thread
+struct ChunkBuffer {
+  glm::ivec2 pos;
+  bool generated;  // false: nothing on disk, chunk needs to be generated
+  BlockBuffer data;  // Empty unless generated
+  BlockEdits edits;
+  bool edits_complete;  // edits holds every change since generation
+};
+
+enum class RegionRequestType {
+  Load,   // Read chunks[].pos
+  Save,   // Write chunks[], other chunks of the region are left untouched
+  Patch,  // Apply chunks[].edits to the region on disk
+  JournalAppend,
+  JournalTruncate
+};
+
+// Chunks of a request all belong to the region at pos
+struct RegionRequest {
+  enum RegionRequestType type;
+  glm::ivec2 pos;
+  std::string filename;  // Region file, or journal for Journal* requests
+  enum CodecId codec;    // Save and Patch
+  std::vector<ChunkBuffer> chunks;
+  std::vector<io::JournalEntry> journal;  // JournalAppend only
+};
+
+struct RegionResult {
+  glm::ivec2 pos;
+  std::vector<ChunkBuffer> chunks;
+};
+
+// Where a chunk lives in its region file, size 0 if it was never written
+struct RegionEntry {
+  uint32_t offset = 0;
+  uint32_t size = 0;
+  enum CodecId codec = CodecId::RLE;
+};
+
+// Open region file, only touched by the I/O thread
+struct RegionFile {
+  std::string filename;
+  FILE* file = nullptr;  // nullptr until first written, or legacy layout
+  bool legacy = false;
+  size_t size = 0;        // Bytes in the file
+  size_t live_bytes = 0;  // Bytes still referenced by an entry
+  size_t last_use = 0;
+  bool unsynced = false;  // Written since the last fsync
+  RegionEntry entries[CHUNK_PER_REGION];
+  io::MappedFile mapping;  // Reads, remapped when the file outgrows it
+};
+
+struct CodecStats {
+  size_t chunks_encoded = 0;
+  size_t bytes_encoded = 0;
+  double encode_time = 0.0;  // seconds
+  size_t chunks_decoded = 0;
+  double decode_time = 0.0;  // seconds
+};
+
+// Owns a single thread doing every region file access.
+// Requests are processed in order so a Save followed by a Load of the same
+// chunk always reads back what was just written. Region writes are synced
+// to disk before a JournalTruncate drops the edits they hold.
+class RegionWorker {
+ public:
+  RegionWorker(void);
+  ~RegionWorker(void);
+
+  void push(RegionRequest request);
+  bool poll(RegionResult& result);
+  size_t pending();
+  CodecStats getCodecStats(CodecId id);
+
+ private:
+  RegionWorker(RegionWorker const& src);
+  RegionWorker& operator=(RegionWorker const& rhs);
+  void run();
+  void loadRegion(const RegionRequest& request, RegionResult& result);
+  void saveRegion(const RegionRequest& request);
+  void patchRegion(const RegionRequest& request);
+  size_t encodeChunk(const ChunkBuffer& chunk, enum CodecId codec_id,
+                     std::vector<unsigned char>& encoded);
+  void readChunk(RegionFile& region, int index, ChunkBuffer& chunk);
+  RegionFile* openRegion(const std::string& filename);
+  bool rewriteRegion(RegionFile& region);
+  void closeRegion(RegionFile& region);
+  void syncRegions();
+  const io::MappedFile* getMapping(RegionFile& region, size_t end);
+
+  std::mutex _mutex;
+  std::condition_variable _cv;
+  std::deque<RegionRequest> _requests;
+  std::deque<RegionResult> _results;
+  size_t _in_flight;
+  bool _running;
+  CodecStats _stats[CODEC_COUNT];
+  // Open regions with their parsed headers, at most REGION_OPEN_FILES
+  std::unordered_map<std::string, RegionFile> _regions;
+  size_t _region_uses;
+  std::thread _thread;
+};
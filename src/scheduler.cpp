@@ -0,0 +1,85 @@
+#include "scheduler.hpp"
+
+FrameScheduler::FrameScheduler(void)
+    : _budget(SCHEDULER_MIN_BUDGET),
+      _other_time(0.0f),
+      _work_time(0.0f),
+      _tasks(0),
+      _last_tasks(0) {
+  for (int i = 0; i < TASK_TYPE_COUNT; i++) {
+    _cost[i] = 0.0f;
+  }
+  _frame_start = std::chrono::steady_clock::now();
+}
+
+FrameScheduler::FrameScheduler(FrameScheduler const& src) { *this = src; }
+
+FrameScheduler::~FrameScheduler(void) {}
+
+FrameScheduler& FrameScheduler::operator=(FrameScheduler const& rhs) {
+  if (this != &rhs) {
+    this->_frame_start = rhs._frame_start;
+    this->_task_start = rhs._task_start;
+    this->_budget = rhs._budget;
+    this->_other_time = rhs._other_time;
+    this->_work_time = rhs._work_time;
+    for (int i = 0; i < TASK_TYPE_COUNT; i++) {
+      this->_cost[i] = rhs._cost[i];
+    }
+    this->_tasks = rhs._tasks;
+    this->_last_tasks = rhs._last_tasks;
+  }
+  return (*this);
+}
+
+float FrameScheduler::elapsed() const {
+  std::chrono::duration<float, std::milli> elapsed =
+      std::chrono::steady_clock::now() - _frame_start;
+  return (elapsed.count());
+}
+
+void FrameScheduler::beginFrame(float delta_time) {
+  float other_time = delta_time * 1000.0f - _work_time;
+  if (other_time < 0.0f) {
+    other_time = 0.0f;
+  }
+  // Smoothed so a single slow frame does not starve the queues
+  _other_time += (other_time - _other_time) * 0.1f;
+  _budget = (1000.0f / SCHEDULER_TARGET_FPS) - _other_time;
+  if (_budget < SCHEDULER_MIN_BUDGET) {
+    _budget = SCHEDULER_MIN_BUDGET;
+  } else if (_budget > SCHEDULER_MAX_BUDGET) {
+    _budget = SCHEDULER_MAX_BUDGET;
+  }
+  _last_tasks = _tasks;
+  _tasks = 0;
+  _frame_start = std::chrono::steady_clock::now();
+}
+
+bool FrameScheduler::canRun(TaskType type) const {
+  return (_tasks == 0 ||
+          elapsed() + _cost[static_cast<int>(type)] <= _budget);
+}
+
+void FrameScheduler::beginTask() {
+  _task_start = std::chrono::steady_clock::now();
+}
+
+void FrameScheduler::endTask(TaskType type) {
+  std::chrono::duration<float, std::milli> cost =
+      std::chrono::steady_clock::now() - _task_start;
+  float& average = _cost[static_cast<int>(type)];
+  average = (average == 0.0f) ? cost.count()
+                              : average + (cost.count() - average) * 0.1f;
+  _tasks++;
+}
+
+void FrameScheduler::endFrame() { _work_time = elapsed(); }
+
+float FrameScheduler::getBudget() const { return (_budget); }
+
+float FrameScheduler::getTaskCost(TaskType type) const {
+  return (_cost[static_cast<int>(type)]);
+}
+
+size_t FrameScheduler::getTasksRun() const { return (_last_tasks); }
@@ -0,0 +1,43 @@
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include "ft_vox.hpp"
+
+// Render thread work, generation and meshing run on the job pool
+enum class TaskType { Integrate, Upload };
+#define TASK_TYPE_COUNT 2
+
+// Runs chunk work until a per-frame time budget is spent. The budget is
+// what the target frame time leaves once the rest of the frame (render,
+// input...) is paid, as measured over the previous frames.
+// Each task type keeps an average cost so a task that would overrun the
+// budget is left for the next frame. The first task of a frame always
+// runs, queues never stall.
+class FrameScheduler {
+ public:
+  FrameScheduler(void);
+  FrameScheduler(FrameScheduler const& src);
+  ~FrameScheduler(void);
+  FrameScheduler& operator=(FrameScheduler const& rhs);
+
+  void beginFrame(float delta_time);  // seconds, from Env
+  void endFrame();
+  bool canRun(TaskType type) const;
+  void beginTask();
+  void endTask(TaskType type);
+  float getBudget() const;                // ms
+  float getTaskCost(TaskType type) const;  // ms
+  size_t getTasksRun() const;             // during the last frame
+
+ private:
+  float elapsed() const;  // ms since beginFrame
+
+  std::chrono::steady_clock::time_point _frame_start;
+  std::chrono::steady_clock::time_point _task_start;
+  float _budget;
+  float _other_time;  // Frame time not spent on tasks, smoothed
+  float _work_time;   // Spent between beginFrame and endFrame
+  float _cost[TASK_TYPE_COUNT];
+  size_t _tasks;
+  size_t _last_tasks;
+};
@@ -0,0 +1,274 @@
+#include "section.hpp"
+#include <algorithm>
+#include <cstring>
+
+// Index width for a palette, only widths dividing 8
+inline unsigned char bits_for(int palette_size) {
+  if (palette_size <= 1) {
+    return (0);
+  } else if (palette_size <= 2) {
+    return (1);
+  } else if (palette_size <= 4) {
+    return (2);
+  }
+  return (4);
+}
+
+inline void write_index(Section& section, int block, int slot) {
+  int bit = block * section.bits;
+  unsigned char mask = static_cast<unsigned char>(((1 << section.bits) - 1)
+                                                  << (bit & 7));
+  unsigned char& byte = section.indices[bit >> 3];
+  byte = static_cast<unsigned char>((byte & ~mask) | (slot << (bit & 7)));
+}
+
+SectionView SectionIterator::operator*() const {
+  return (_sections->getSection(_id));
+}
+
+ChunkSections::ChunkSections(void) : _filled(false) {
+  std::fill(_counts, _counts + MODEL_PER_CHUNK, 0);
+  std::fill(_heights, _heights + CHUNK_SIZE * CHUNK_SIZE, 0);
+}
+
+ChunkSections::ChunkSections(ChunkSections&& src) : _filled(src._filled) {
+  for (int i = 0; i < MODEL_PER_CHUNK; i++) {
+    _sections[i] = std::move(src._sections[i]);
+  }
+  std::copy(src._counts, src._counts + MODEL_PER_CHUNK, _counts);
+  std::copy(src._heights, src._heights + CHUNK_SIZE * CHUNK_SIZE, _heights);
+  src.reset();
+}
+
+ChunkSections::~ChunkSections(void) {}
+
+ChunkSections& ChunkSections::operator=(ChunkSections&& rhs) {
+  if (this != &rhs) {
+    this->_filled = rhs._filled;
+    for (int i = 0; i < MODEL_PER_CHUNK; i++) {
+      this->_sections[i] = std::move(rhs._sections[i]);
+    }
+    std::copy(rhs._counts, rhs._counts + MODEL_PER_CHUNK, this->_counts);
+    std::copy(rhs._heights, rhs._heights + CHUNK_SIZE * CHUNK_SIZE,
+              this->_heights);
+    rhs.reset();
+  }
+  return (*this);
+}
+
+bool ChunkSections::empty() const { return (!_filled); }
+
+void ChunkSections::reset() {
+  for (int i = 0; i < MODEL_PER_CHUNK; i++) {
+    _sections[i] = Section();
+  }
+  std::fill(_counts, _counts + MODEL_PER_CHUNK, 0);
+  std::fill(_heights, _heights + CHUNK_SIZE * CHUNK_SIZE, 0);
+  _filled = false;
+}
+
+void ChunkSections::assign(const Block* data) {
+  for (int i = 0; i < MODEL_PER_CHUNK; i++) {
+    const Block* blocks = data + i * SECTION_BLOCKS;
+    Section& section = _sections[i];
+    int slots[256];
+    std::memset(slots, -1, sizeof(slots));
+    section.palette_size = 0;
+    _counts[i] = 0;
+    for (int j = 0; j < SECTION_BLOCKS; j++) {
+      unsigned char material = static_cast<unsigned char>(blocks[j].material);
+      _counts[i] += blocks[j].material != Material::Air ? 1 : 0;
+      if (slots[material] == -1 &&
+          section.palette_size < SECTION_PALETTE_MAX) {
+        slots[material] = section.palette_size;
+        section.palette[section.palette_size++] = blocks[j].material;
+      }
+    }
+    section.bits = bits_for(section.palette_size);
+    if (section.bits == 0) {
+      std::vector<unsigned char>().swap(section.indices);
+      continue;
+    }
+    // Fresh vector: a narrower width also gives the wider buffer back
+    std::vector<unsigned char>(SECTION_BLOCKS * section.bits / 8, 0)
+        .swap(section.indices);
+    int per_byte = 8 / section.bits;
+    for (int j = 0; j < SECTION_BLOCKS; j += per_byte) {
+      unsigned int byte = 0;
+      for (int k = 0; k < per_byte; k++) {
+        byte |= static_cast<unsigned int>(
+                    slots[static_cast<unsigned char>(blocks[j + k].material)])
+                << (k * section.bits);
+      }
+      section.indices[j / per_byte] = static_cast<unsigned char>(byte);
+    }
+  }
+  // Columns top down, from the highest section holding anything
+  for (int column = 0; column < CHUNK_SIZE * CHUNK_SIZE; column++) {
+    int x = column / CHUNK_SIZE;
+    int z = column % CHUNK_SIZE;
+    _heights[column] = 0;
+    for (int i = MODEL_PER_CHUNK - 1; i >= 0 && _heights[column] == 0; i--) {
+      if (_counts[i] == 0) {
+        continue;
+      }
+      for (int y = (i + 1) * MODEL_HEIGHT - 1; y >= i * MODEL_HEIGHT; y--) {
+        if (data[BlockLayout::index(x, y, z)].material != Material::Air) {
+          _heights[column] = static_cast<uint16_t>(y + 1);
+          break;
+        }
+      }
+    }
+  }
+  _filled = true;
+}
+
+void ChunkSections::copyTo(Block* data) const {
+  for (const SectionView& section : *this) {
+    Block* dest = data + section.id * SECTION_BLOCKS;
+    if (section.uniform) {
+      std::fill(dest, dest + SECTION_BLOCKS, Block(section.material));
+    } else {
+      unpack(section.id, dest);
+    }
+  }
+}
+
+void ChunkSections::unpack(int id, Block* data) const {
+  const Section& section = _sections[id];
+  if (section.bits == 0) {
+    std::fill(data, data + SECTION_BLOCKS, Block(section.palette[0]));
+    return;
+  }
+  // Every value of a packed byte decoded at once
+  int per_byte = 8 / section.bits;
+  int mask = (1 << section.bits) - 1;
+  Block table[256][8];
+  for (int byte = 0; byte < 256; byte++) {
+    for (int k = 0; k < per_byte; k++) {
+      table[byte][k] =
+          Block(section.palette[(byte >> (k * section.bits)) & mask]);
+    }
+  }
+  for (size_t i = 0; i < section.indices.size(); i++) {
+    std::memcpy(data + i * per_byte, table[section.indices[i]],
+                per_byte * sizeof(Block));
+  }
+}
+
+void ChunkSections::set(int index, Block block) {
+  Section& section = _sections[index / SECTION_BLOCKS];
+  Block previous = get(index);
+  _filled = true;
+  int slot = 0;
+  while (slot < section.palette_size &&
+         section.palette[slot] != block.material) {
+    slot++;
+  }
+  if (slot == section.palette_size) {
+    if (section.palette_size == SECTION_PALETTE_MAX) {
+      return;
+    }
+    if (section.palette_size == (1 << section.bits)) {
+      widen(section);
+    }
+    section.palette[section.palette_size++] = block.material;
+  }
+  if (section.bits > 0) {
+    write_index(section, index % SECTION_BLOCKS, slot);
+  }
+  bool was_air = previous.material == Material::Air;
+  bool is_air = block.material == Material::Air;
+  if (was_air != is_air) {
+    _counts[index / SECTION_BLOCKS] += is_air ? -1 : 1;
+    glm::ivec3 pos = BlockLayout::position(index);
+    int column = pos.x * CHUNK_SIZE + pos.z;
+    if (!is_air && pos.y + 1 > _heights[column]) {
+      _heights[column] = static_cast<uint16_t>(pos.y + 1);
+    } else if (is_air && pos.y + 1 == _heights[column]) {
+      updateHeight(pos.x, pos.z);
+    }
+  }
+}
+
+// Top block of the column was removed, next one down
+void ChunkSections::updateHeight(int x, int z) {
+  int column = x * CHUNK_SIZE + z;
+  for (int y = _heights[column] - 1; y >= 0; y--) {
+    if (_counts[y / MODEL_HEIGHT] == 0) {
+      y -= y % MODEL_HEIGHT;
+      continue;
+    }
+    if (get(BlockLayout::index(x, y, z)).material != Material::Air) {
+      _heights[column] = static_cast<uint16_t>(y + 1);
+      return;
+    }
+  }
+  _heights[column] = 0;
+}
+
+bool ChunkSections::getBounds(glm::ivec3& min, glm::ivec3& max) const {
+  int lowest = 0;
+  while (lowest < MODEL_PER_CHUNK && _counts[lowest] == 0) {
+    lowest++;
+  }
+  if (lowest == MODEL_PER_CHUNK) {
+    return (false);
+  }
+  min = glm::ivec3(CHUNK_SIZE, CHUNK_HEIGHT, CHUNK_SIZE);
+  max = glm::ivec3(-1);
+  for (int x = 0; x < CHUNK_SIZE; x++) {
+    for (int z = 0; z < CHUNK_SIZE; z++) {
+      int height = getHeight(x, z);
+      if (height >= 0) {
+        min = glm::min(min, glm::ivec3(x, min.y, z));
+        max = glm::max(max, glm::ivec3(x, height, z));
+      }
+    }
+  }
+  // Only the lowest section holding anything is looked at
+  for (int y = lowest * MODEL_HEIGHT; y < (lowest + 1) * MODEL_HEIGHT; y++) {
+    for (int x = 0; x < CHUNK_SIZE; x++) {
+      for (int z = 0; z < CHUNK_SIZE; z++) {
+        if (get(BlockLayout::index(x, y, z)).material != Material::Air) {
+          min.y = y;
+          return (true);
+        }
+      }
+    }
+  }
+  return (true);
+}
+
+// Next index width, existing indices are kept
+void ChunkSections::widen(Section& section) {
+  Section widened;
+  widened.bits = section.bits == 0 ? 1 : section.bits * 2;
+  widened.indices.assign(SECTION_BLOCKS * widened.bits / 8, 0);
+  if (section.bits > 0) {
+    int mask = (1 << section.bits) - 1;
+    for (int i = 0; i < SECTION_BLOCKS; i++) {
+      int bit = i * section.bits;
+      write_index(widened, i, (section.indices[bit >> 3] >> (bit & 7)) & mask);
+    }
+  }
+  section.bits = widened.bits;
+  section.indices.swap(widened.indices);
+}
+
+SectionView ChunkSections::getSection(int id) const {
+  SectionView view;
+  view.id = id;
+  view.uniform = _sections[id].bits == 0;
+  view.material = _sections[id].palette[0];
+  view.palette_size = _sections[id].palette_size;
+  return (view);
+}
+
+size_t ChunkSections::getMemoryUsage() const {
+  size_t bytes = sizeof(*this);
+  for (int i = 0; i < MODEL_PER_CHUNK; i++) {
+    bytes += _sections[i].indices.capacity();
+  }
+  return (bytes);
+}
@@ -0,0 +1,110 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "ft_vox.hpp"
+#include "layout.hpp"
+
+#define SECTION_PALETTE_MAX 16  // Every Material fits, 4 bits indices
+
+// MODEL_HEIGHT layers of a chunk, as a palette of the materials it holds
+// and one index per block, packed on 0 (uniform), 1, 2 or 4 bits so an
+// index never straddles two bytes. Entries are never removed from the
+// palette, ChunkSections::assign rebuilds it.
+struct Section {
+  unsigned char bits = 0;
+  unsigned char palette_size = 1;
+  enum Material palette[SECTION_PALETTE_MAX] = {Material::Air};
+  std::vector<unsigned char> indices;  // SECTION_BLOCKS * bits / 8 bytes
+};
+
+// What a SectionIterator points to
+struct SectionView {
+  int id;                  // y / MODEL_HEIGHT
+  bool uniform;            // Only material, no index stored
+  enum Material material;  // Every block of a uniform section
+  int palette_size;
+};
+
+class ChunkSections;
+
+// Sections of a chunk, bottom to top
+class SectionIterator {
+ public:
+  SectionIterator(const ChunkSections* sections, int id)
+      : _sections(sections), _id(id){};
+
+  SectionView operator*() const;
+  SectionIterator& operator++() {
+    _id++;
+    return (*this);
+  };
+  bool operator!=(const SectionIterator& rhs) const {
+    return (_id != rhs._id);
+  };
+
+ private:
+  const ChunkSections* _sections;
+  int _id;
+};
+
+// Blocks of a chunk as MODEL_PER_CHUNK sections, the granularity of
+// Chunk::dirty. Uniform sections (air above the terrain, stone deep down)
+// only keep their material, the others a palette and packed indices that
+// are widened when set() brings a new material in.
+// Indices are the ones of flat chunk buffers (BlockLayout), a section is a
+// contiguous range of them.
+// A summary of where the solid blocks are (top of each column, non-air
+// count of each section) is rebuilt by assign() and kept up to date by
+// set(), so queries never scan blocks.
+// Move only, copies go through flat buffers.
+class ChunkSections {
+ public:
+  ChunkSections(void);  // Empty: nothing generated yet, reads as air
+  ChunkSections(ChunkSections&& src);
+  ~ChunkSections(void);
+  ChunkSections& operator=(ChunkSections&& rhs);
+
+  bool empty() const;
+  void reset();
+  // From and to a flat CHUNK_BLOCKS buffer
+  void assign(const Block* data);
+  void copyTo(Block* data) const;
+  // Bulk decode of one section into SECTION_BLOCKS blocks
+  void unpack(int id, Block* data) const;
+  Block get(int index) const {
+    const Section& section = _sections[index / SECTION_BLOCKS];
+    if (section.bits == 0) {
+      return (Block(section.palette[0]));
+    }
+    int bit = (index % SECTION_BLOCKS) * section.bits;
+    return (Block(section.palette[(section.indices[bit >> 3] >> (bit & 7)) &
+                                  ((1 << section.bits) - 1)]));
+  };
+  void set(int index, Block block);
+  // Highest non-air y of a column, -1 if the column is all air
+  int getHeight(int x, int z) const {
+    return (static_cast<int>(_heights[x * CHUNK_SIZE + z]) - 1);
+  };
+  int getBlockCount(int id) const { return (_counts[id]); };  // Non-air
+  // Smallest box around the non-air blocks, false if there are none
+  bool getBounds(glm::ivec3& min, glm::ivec3& max) const;
+  SectionView getSection(int id) const;
+  size_t getMemoryUsage() const;  // Bytes, palettes and indices
+
+  SectionIterator begin() const { return (SectionIterator(this, 0)); };
+  SectionIterator end() const {
+    return (SectionIterator(this, MODEL_PER_CHUNK));
+  };
+
+ private:
+  ChunkSections(ChunkSections const& src);
+  ChunkSections& operator=(ChunkSections const& rhs);
+  void widen(Section& section);
+  void updateHeight(int x, int z);
+
+  bool _filled;
+  Section _sections[MODEL_PER_CHUNK];
+  uint16_t _counts[MODEL_PER_CHUNK];
+  uint16_t _heights[CHUNK_SIZE * CHUNK_SIZE];  // Top non-air y + 1, or 0
+};
@@ -0,0 +1,193 @@
+#include "store.hpp"
+#include "chunk.hpp"
+
+#define STORE_FALLBACK_CAPACITY 16
+
+ChunkStore::ChunkStore(void)
+    : ChunkStore(RENDER_DISTANCE_MAX + CHUNK_UNLOAD_MARGIN) {}
+
+ChunkStore::ChunkStore(int radius) : _extent(1), _fallback_count(0) {
+  while (_extent < radius * 2 + 1) {
+    _extent <<= 1;
+  }
+  Slot empty = {glm::ivec2(0), nullptr, 0};
+  _ring.assign(_extent * _extent, empty);
+  _fallback.assign(STORE_FALLBACK_CAPACITY, empty);
+}
+
+ChunkStore::~ChunkStore(void) { clear(); }
+
+size_t ChunkStore::ringIndex(glm::ivec2 pos) const {
+  int mask = _extent - 1;
+  return (((pos.x >> 4) & mask) * _extent + ((pos.y >> 4) & mask));
+}
+
+size_t ChunkStore::fallbackIndex(glm::ivec2 pos) const {
+  return (ivec2Comparator()(pos) & (_fallback.size() - 1));
+}
+
+Chunk* ChunkStore::find(glm::ivec2 pos) const {
+  const Slot& slot = _ring[ringIndex(pos)];
+  if (slot.chunk != nullptr && slot.pos == pos) {
+    return (slot.chunk);
+  }
+  if (_fallback_count == 0) {
+    return (nullptr);
+  }
+  size_t mask = _fallback.size() - 1;
+  for (size_t i = fallbackIndex(pos); _fallback[i].chunk != nullptr;
+       i = (i + 1) & mask) {
+    if (_fallback[i].pos == pos) {
+      return (_fallback[i].chunk);
+    }
+  }
+  return (nullptr);
+}
+
+ChunkStore::Slot* ChunkStore::findSlot(glm::ivec2 pos) {
+  Slot& slot = _ring[ringIndex(pos)];
+  if (slot.chunk != nullptr && slot.pos == pos) {
+    return (&slot);
+  }
+  size_t mask = _fallback.size() - 1;
+  for (size_t i = fallbackIndex(pos); _fallback[i].chunk != nullptr;
+       i = (i + 1) & mask) {
+    if (_fallback[i].pos == pos) {
+      return (&_fallback[i]);
+    }
+  }
+  return (nullptr);
+}
+
+Chunk* ChunkStore::insert(glm::ivec2 pos, bool& inserted) {
+  Chunk* chunk = find(pos);
+  inserted = chunk == nullptr;
+  if (chunk != nullptr) {
+    return (chunk);
+  }
+  chunk = new Chunk(glm::ivec3(pos.x, 0, pos.y));
+  Slot slot = {pos, chunk, _chunks.size()};
+  _chunks.push_back(chunk);
+  Slot& ring_slot = _ring[ringIndex(pos)];
+  if (ring_slot.chunk == nullptr) {
+    ring_slot = slot;
+  } else {
+    insertFallback(slot);
+  }
+  link(pos, chunk);
+  return (chunk);
+}
+
+void ChunkStore::insertFallback(const Slot& slot) {
+  // Load factor kept under 1/2, probe sequences stay short
+  if ((_fallback_count + 1) * 2 > _fallback.size()) {
+    std::vector<Slot> old_slots(_fallback.size() * 2,
+                                Slot{glm::ivec2(0), nullptr, 0});
+    old_slots.swap(_fallback);
+    _fallback_count = 0;
+    for (const auto& old_slot : old_slots) {
+      if (old_slot.chunk != nullptr) {
+        insertFallback(old_slot);
+      }
+    }
+  }
+  size_t mask = _fallback.size() - 1;
+  size_t i = fallbackIndex(slot.pos);
+  while (_fallback[i].chunk != nullptr) {
+    i = (i + 1) & mask;
+  }
+  _fallback[i] = slot;
+  _fallback_count++;
+}
+
+bool ChunkStore::eraseFallback(glm::ivec2 pos) {
+  size_t mask = _fallback.size() - 1;
+  size_t i = fallbackIndex(pos);
+  while (_fallback[i].chunk != nullptr && _fallback[i].pos != pos) {
+    i = (i + 1) & mask;
+  }
+  if (_fallback[i].chunk == nullptr) {
+    return (false);
+  }
+  // Backward shift: pull back the entries that probed past the hole
+  size_t hole = i;
+  for (size_t j = (i + 1) & mask; _fallback[j].chunk != nullptr;
+       j = (j + 1) & mask) {
+    size_t home = fallbackIndex(_fallback[j].pos);
+    if (((j - home) & mask) >= ((j - hole) & mask)) {
+      _fallback[hole] = _fallback[j];
+      hole = j;
+    }
+  }
+  _fallback[hole].chunk = nullptr;
+  _fallback_count--;
+  return (true);
+}
+
+void ChunkStore::erase(glm::ivec2 pos) {
+  Slot& ring_slot = _ring[ringIndex(pos)];
+  Chunk* chunk;
+  size_t index;
+  if (ring_slot.chunk != nullptr && ring_slot.pos == pos) {
+    chunk = ring_slot.chunk;
+    index = ring_slot.index;
+    ring_slot.chunk = nullptr;
+  } else {
+    Slot* slot = findSlot(pos);
+    if (slot == nullptr) {
+      return;
+    }
+    chunk = slot->chunk;
+    index = slot->index;
+    eraseFallback(pos);
+  }
+  link(pos, nullptr);
+  // Swap with the last chunk, its slot follows
+  Chunk* last = _chunks.back();
+  _chunks[index] = last;
+  _chunks.pop_back();
+  if (last != chunk) {
+    glm::ivec3 last_pos = last->get_pos();
+    findSlot(glm::ivec2(last_pos.x, last_pos.z))->index = index;
+  }
+  delete chunk;
+}
+
+// Points the 8 resident chunks around pos at chunk, and chunk at them
+void ChunkStore::link(glm::ivec2 pos, Chunk* chunk) {
+  for (int dx = -1; dx <= 1; dx++) {
+    for (int dz = -1; dz <= 1; dz++) {
+      if (dx == 0 && dz == 0) {
+        continue;
+      }
+      Chunk* neighbour = find(pos + glm::ivec2(dx, dz) * CHUNK_SIZE);
+      if (neighbour == nullptr) {
+        continue;
+      }
+      neighbour->_neighbours[(1 - dx) * 3 + 1 - dz] = chunk;
+      if (chunk != nullptr) {
+        chunk->_neighbours[(dx + 1) * 3 + dz + 1] = neighbour;
+      }
+    }
+  }
+}
+
+void ChunkStore::clear() {
+  for (auto chunk : _chunks) {
+    delete chunk;
+  }
+  _chunks.clear();
+  for (auto& slot : _ring) {
+    slot.chunk = nullptr;
+  }
+  for (auto& slot : _fallback) {
+    slot.chunk = nullptr;
+  }
+  _fallback_count = 0;
+}
+
+const std::vector<Chunk*>& ChunkStore::chunks() const { return (_chunks); }
+
+size_t ChunkStore::size() const { return (_chunks.size()); }
+
+size_t ChunkStore::getFallbackCount() const { return (_fallback_count); }
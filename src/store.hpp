@@ -0,0 +1,52 @@
+#pragma once
+#define GLM_ENABLE_EXPERIMENTAL
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <vector>
+#include "ft_vox.hpp"
+
+class Chunk;
+
+// Resident chunks, owned by the store.
+// Lookups go through a 2D ring of slots indexed by chunk coordinate modulo
+// the extent (toroidal, nothing moves when the player does). The extent
+// covers the largest resident area, so resident chunks never share a slot
+// and a lookup is a mask and a compare. A chunk finding its slot taken
+// (ie. loaded far away) goes to a small open addressing map instead.
+// Chunks are linked to their resident neighbours on insert and unlinked
+// on erase, see Chunk::getNeighbour.
+class ChunkStore {
+ public:
+  ChunkStore(void);        // Sized for RENDER_DISTANCE_MAX
+  ChunkStore(int radius);  // Chunks, radius of the resident area
+  ~ChunkStore(void);
+
+  Chunk* find(glm::ivec2 pos) const;  // nullptr if not resident
+  Chunk* insert(glm::ivec2 pos, bool& inserted);
+  void erase(glm::ivec2 pos);
+  void clear();
+  const std::vector<Chunk*>& chunks() const;  // Unordered
+  size_t size() const;
+  size_t getFallbackCount() const;
+
+ private:
+  struct Slot {
+    glm::ivec2 pos;
+    Chunk* chunk;  // nullptr: empty
+    size_t index;  // In _chunks
+  };
+  ChunkStore(ChunkStore const& src);
+  ChunkStore& operator=(ChunkStore const& rhs);
+  size_t ringIndex(glm::ivec2 pos) const;
+  Slot* findSlot(glm::ivec2 pos);
+  size_t fallbackIndex(glm::ivec2 pos) const;
+  void insertFallback(const Slot& slot);
+  bool eraseFallback(glm::ivec2 pos);
+  void link(glm::ivec2 pos, Chunk* chunk);  // nullptr: unlink
+
+  int _extent;  // Power of two
+  std::vector<Slot> _ring;
+  std::vector<Slot> _fallback;  // Linear probing, power of two capacity
+  size_t _fallback_count;
+  std::vector<Chunk*> _chunks;
+};
@@ -0,0 +1,68 @@
+// Chunk codec benchmark: bytes per chunk and encode/decode MB/s of every
+// block codec on generated terrain. Exits with 1 if a chunk does not
+// decode back to the generated blocks.
+#include <chrono>
+#include <iostream>
+#include <vector>
+#include "codec.hpp"
+#include "generator.hpp"
+
+#define BENCH_SEED 42
+#define BENCH_WORLD 16  // Chunks per side
+#define BENCH_ROUNDS 5
+
+bool bench(const ChunkCodec& codec,
+           const std::vector<std::vector<Block> >& chunks) {
+  std::vector<unsigned char> encoded(codec.maxEncodedSize());
+  std::vector<Block> decoded(CHUNK_BLOCKS);
+  double encode_time = 0.0;
+  double decode_time = 0.0;
+  size_t bytes = 0;
+  for (int round = 0; round < BENCH_ROUNDS; round++) {
+    for (const auto& chunk : chunks) {
+      // Air filled, as region reads do: RLE drops the last run
+      std::fill(decoded.begin(), decoded.end(), Block());
+      auto start = std::chrono::steady_clock::now();
+      size_t size = codec.encode(chunk.data(), encoded.data());
+      auto middle = std::chrono::steady_clock::now();
+      bool ok = codec.decode(encoded.data(), size, decoded.data());
+      auto end = std::chrono::steady_clock::now();
+      if (ok == false || decoded != chunk) {
+        std::cerr << codec.name() << ": chunk does not round trip"
+                  << std::endl;
+        return (false);
+      }
+      encode_time += std::chrono::duration<double>(middle - start).count();
+      decode_time += std::chrono::duration<double>(end - middle).count();
+      bytes += size;
+    }
+  }
+  size_t count = chunks.size() * BENCH_ROUNDS;
+  double mb = count * CHUNK_BLOCKS / (1024.0 * 1024.0);
+  std::cout << codec.name() << ": " << bytes / count << " B/chunk, encode "
+            << static_cast<int>(mb / encode_time) << " MB/s, decode "
+            << static_cast<int>(mb / decode_time) << " MB/s" << std::endl;
+  return (true);
+}
+
+int main(void) {
+  generator::init(10000, BENCH_SEED);
+  std::vector<std::vector<Block> > chunks;
+  std::vector<Biome> biome(CHUNK_SIZE * CHUNK_SIZE);
+  for (int x = 0; x < BENCH_WORLD; x++) {
+    for (int z = 0; z < BENCH_WORLD; z++) {
+      chunks.push_back(std::vector<Block>(CHUNK_BLOCKS));
+      generator::generate_chunk(
+          chunks.back().data(), biome.data(),
+          glm::vec3(x * CHUNK_SIZE, 0, z * CHUNK_SIZE));
+    }
+  }
+  std::cout << chunks.size() << " chunks, seed " << BENCH_SEED << std::endl;
+  for (int id = 0; id < CODEC_COUNT; id++) {
+    const ChunkCodec* codec = getChunkCodec(static_cast<CodecId>(id));
+    if (codec != nullptr && bench(*codec, chunks) == false) {
+      return (1);
+    }
+  }
+  return (0);
+}
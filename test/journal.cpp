@@ -0,0 +1,97 @@
+// Edit journal crash test: a journal cut anywhere, or with a corrupted
+// batch, must replay every batch before it and nothing after it.
+// Exits with 1 on failure.
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <random>
+#include <vector>
+#include "io.hpp"
+
+#define TEST_JOURNAL "journal_test.log"
+#define JOURNAL_BATCHES 6
+
+std::vector<char> read_file(const char* filename) {
+  std::ifstream file(filename, std::ios::binary);
+  return (std::vector<char>(std::istreambuf_iterator<char>(file),
+                            std::istreambuf_iterator<char>()));
+}
+
+void write_file(const char* filename, const std::vector<char>& bytes) {
+  std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+  file.write(bytes.data(), bytes.size());
+}
+
+// Replayed entries must be the first `batches` batches, in order
+bool check(const char* what, size_t size,
+           const std::vector<std::vector<io::JournalEntry> >& written,
+           size_t batches) {
+  std::vector<io::JournalEntry> expected;
+  for (size_t i = 0; i < batches; i++) {
+    expected.insert(expected.end(), written[i].begin(), written[i].end());
+  }
+  std::vector<io::JournalEntry> replayed;
+  io::readJournal(TEST_JOURNAL, replayed);
+  bool same = replayed.size() == expected.size();
+  for (size_t i = 0; same && i < replayed.size(); i++) {
+    same = replayed[i].pos == expected[i].pos &&
+           replayed[i].material == expected[i].material;
+  }
+  if (same == false) {
+    std::cerr << what << " at " << size << " bytes: " << replayed.size()
+              << " entries replayed, expected " << expected.size()
+              << std::endl;
+  }
+  return (same);
+}
+
+int main(void) {
+  std::mt19937 rng(11);
+  std::remove(TEST_JOURNAL);
+  std::vector<std::vector<io::JournalEntry> > written(JOURNAL_BATCHES);
+  // Journal size once each batch is complete
+  std::vector<size_t> ends(1, 0);
+  for (auto& batch : written) {
+    batch.resize(1 + rng() % 40);
+    for (auto& entry : batch) {
+      entry.pos = glm::ivec3(static_cast<int>(rng() % 2001) - 1000,
+                             rng() % CHUNK_HEIGHT,
+                             static_cast<int>(rng() % 2001) - 1000);
+      entry.material = static_cast<Material>(rng() % 13);
+    }
+    if (io::appendJournal(TEST_JOURNAL, batch) == false) {
+      std::cerr << "cannot write " << TEST_JOURNAL << std::endl;
+      return (1);
+    }
+    ends.push_back(read_file(TEST_JOURNAL).size());
+  }
+  std::vector<char> journal = read_file(TEST_JOURNAL);
+  bool ok = check("complete", journal.size(), written, JOURNAL_BATCHES);
+  // Torn by a crash: every length, down to an empty journal
+  size_t complete = 0;
+  for (size_t size = 0; ok && size < journal.size(); size++) {
+    while (ends[complete + 1] <= size) {
+      complete++;
+    }
+    write_file(TEST_JOURNAL, std::vector<char>(journal.begin(),
+                                               journal.begin() + size));
+    ok = check("torn", size, written, complete);
+  }
+  // A flipped byte anywhere in a batch ends the replay there
+  for (size_t batch = 0; ok && batch < JOURNAL_BATCHES; batch++) {
+    for (size_t byte = ends[batch]; ok && byte < ends[batch + 1]; byte++) {
+      std::vector<char> corrupted(journal);
+      corrupted[byte] ^= 0x20;
+      write_file(TEST_JOURNAL, corrupted);
+      ok = check("bad checksum", byte, written, batch);
+    }
+  }
+  std::remove(TEST_JOURNAL);
+  if (ok == false) {
+    return (1);
+  }
+  std::cout << journal.size() << " journal bytes: replay stops at the last "
+            << "complete batch" << std::endl;
+  return (0);
+}
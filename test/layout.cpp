@@ -0,0 +1,131 @@
+// Block layout benchmark: generator, mesher and raycast timings under the
+// BLOCK_ORDER it is built with (layout_bench_linear, layout_bench_morton).
+// Exits with 1 if the layout is not a bijection or a relayout round trip
+// loses blocks.
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <type_traits>
+#include <vector>
+#include "generator.hpp"
+#include "layout.hpp"
+#include "meshing.hpp"
+#include "raycast.hpp"
+#include "section.hpp"
+
+#define BENCH_SEED 42
+#define BENCH_WORLD 6  // Chunks per side
+#define BENCH_ROUNDS 3
+#define BENCH_RAYS 200000
+
+typedef std::chrono::steady_clock bench_clock;
+
+double elapsed_us(bench_clock::time_point start) {
+  return (std::chrono::duration<double, std::micro>(bench_clock::now() -
+                                                    start)
+              .count());
+}
+
+bool check_layout() {
+  std::vector<bool> seen(CHUNK_BLOCKS, false);
+  for (int y = 0; y < CHUNK_HEIGHT; y++) {
+    for (int x = 0; x < CHUNK_SIZE; x++) {
+      for (int z = 0; z < CHUNK_SIZE; z++) {
+        int index = BlockLayout::index(x, y, z);
+        if (index < 0 || index >= CHUNK_BLOCKS || seen[index] ||
+            index / SECTION_BLOCKS != y / MODEL_HEIGHT ||
+            BlockLayout::position(index) != glm::ivec3(x, y, z) ||
+            edit_index(edit_key(index)) != index) {
+          std::cerr << "bad index for " << x << " " << y << " " << z
+                    << std::endl;
+          return (false);
+        }
+        seen[index] = true;
+      }
+    }
+  }
+  return (true);
+}
+
+int main(void) {
+  if (check_layout() == false) {
+    return (1);
+  }
+  generator::init(10000, BENCH_SEED);
+  std::vector<std::vector<Block> > chunks;
+  std::vector<Biome> biome(CHUNK_SIZE * CHUNK_SIZE);
+  auto start = bench_clock::now();
+  for (int x = 0; x < BENCH_WORLD; x++) {
+    for (int z = 0; z < BENCH_WORLD; z++) {
+      chunks.push_back(std::vector<Block>(CHUNK_BLOCKS));
+      generator::generate_chunk(
+          chunks.back().data(), biome.data(),
+          glm::vec3(x * CHUNK_SIZE, 0, z * CHUNK_SIZE));
+    }
+  }
+  double generate_us = elapsed_us(start) / chunks.size();
+
+  std::vector<Block> file(CHUNK_BLOCKS);
+  std::vector<Block> back(CHUNK_BLOCKS);
+  for (const auto& chunk : chunks) {
+    relayout<BlockLayout, FileLayout>(chunk.data(), file.data());
+    relayout<FileLayout, BlockLayout>(file.data(), back.data());
+    if (back != chunk) {
+      std::cerr << "relayout round trip differs" << std::endl;
+      return (1);
+    }
+  }
+
+  bool dirty[MODEL_PER_CHUNK];
+  std::fill(dirty, dirty + MODEL_PER_CHUNK, true);
+  std::vector<Vertex> vertices[MODEL_PER_CHUNK];
+  size_t vertex_count = 0;
+  start = bench_clock::now();
+  for (int round = 0; round < BENCH_ROUNDS; round++) {
+    for (auto& chunk : chunks) {
+      for (auto& section : vertices) {
+        section.clear();
+      }
+      mesher::greedy(chunk.data(), dirty, vertices);
+      for (const auto& section : vertices) {
+        vertex_count += section.size();
+      }
+    }
+  }
+  double mesh_us = elapsed_us(start) / (BENCH_ROUNDS * chunks.size());
+
+  std::vector<ChunkSections> sections(chunks.size());
+  ChunkSnapshot snapshot;
+  for (size_t i = 0; i < chunks.size(); i++) {
+    sections[i].assign(chunks[i].data());
+    glm::ivec2 pos(i / BENCH_WORLD * CHUNK_SIZE, i % BENCH_WORLD * CHUNK_SIZE);
+    snapshot.add(pos, sections[i]);
+  }
+  std::mt19937 rng(7);
+  std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+  std::vector<Ray> rays(BENCH_RAYS);
+  float world = BENCH_WORLD * CHUNK_SIZE;
+  for (auto& ray : rays) {
+    ray.pos = glm::vec3((unit(rng) + 1.0f) * world / 2, 60.0f + unit(rng) * 20,
+                        (unit(rng) + 1.0f) * world / 2);
+    ray.dir = glm::vec3(unit(rng), unit(rng) - 0.5f, unit(rng));
+    ray.max_dist = 50.0f;
+  }
+  std::vector<HitInfo> hits;
+  start = bench_clock::now();
+  raycast::castRays(snapshot, rays, hits);
+  double ray_ns = elapsed_us(start) * 1000.0 / rays.size();
+  size_t hit_count = 0;
+  for (const auto& hit : hits) {
+    hit_count += hit.hit ? 1 : 0;
+  }
+
+  std::cout << (std::is_same<BLOCK_ORDER, LinearOrder>::value ? "linear"
+                                                              : "morton")
+            << ": generate " << static_cast<int>(generate_us)
+            << " us/chunk, mesh " << static_cast<int>(mesh_us)
+            << " us/chunk (" << vertex_count << " vertices), raycast "
+            << static_cast<int>(ray_ns) << " ns/ray (" << hit_count
+            << " hits)" << std::endl;
+  return (0);
+}
@@ -0,0 +1,184 @@
+// Prefetch comparison: replays a flight path (test/flight_path.txt by
+// default) through prefetch_focus under both PrefetchPolicy values and
+// counts frames where a chunk of the load area inside the view frustum is
+// not ready yet, as the HUD "chunks missing in view" counter does.
+// Loading is modelled as a ChunkQueue centred on the focus that turns a
+// fixed number of chunks per frame into meshes, every chunk of the load
+// area being queued as soon as it enters it.
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <unordered_set>
+#include <vector>
+#include <glm/gtc/matrix_transform.hpp>
+#include "culling.hpp"
+#include "prefetch.hpp"
+#include "queue.hpp"
+
+#define SIM_FPS 60
+#define SIM_RENDER_DISTANCE 10
+
+struct Keyframe {
+  float time;
+  glm::vec3 pos;
+  float yaw;    // Degrees, Camera::horAngle
+  float pitch;  // Degrees, Camera::verAngle
+};
+
+struct Frame {
+  glm::vec3 pos;
+  glm::vec3 dir;
+};
+
+bool read_path(const char* filename, std::vector<Keyframe>& keys) {
+  std::ifstream file(filename);
+  std::string line;
+  while (std::getline(file, line)) {
+    if (line.empty() || line[0] == '#') {
+      continue;
+    }
+    std::istringstream fields(line);
+    Keyframe key;
+    if (!(fields >> key.time >> key.pos.x >> key.pos.y >> key.pos.z >>
+          key.yaw >> key.pitch)) {
+      std::cerr << filename << ": bad keyframe: " << line << std::endl;
+      return (false);
+    }
+    keys.push_back(key);
+  }
+  return (keys.size() >= 2);
+}
+
+// Camera position and direction of every frame
+std::vector<Frame> replay_path(const std::vector<Keyframe>& keys) {
+  std::vector<Frame> frames;
+  size_t key = 0;
+  for (int i = 0; i <= keys.back().time * SIM_FPS; i++) {
+    float time = static_cast<float>(i) / SIM_FPS;
+    while (key + 2 < keys.size() && keys[key + 1].time <= time) {
+      key++;
+    }
+    const Keyframe& a = keys[key];
+    const Keyframe& b = keys[key + 1];
+    float t = std::min(1.0f, (time - a.time) / (b.time - a.time));
+    float turn = std::fmod(b.yaw - a.yaw + 540.0f, 360.0f) - 180.0f;
+    float yaw = glm::radians(a.yaw + turn * t);
+    float pitch = glm::radians(a.pitch + (b.pitch - a.pitch) * t);
+    Frame frame;
+    frame.pos = a.pos + (b.pos - a.pos) * t;
+    frame.dir = glm::vec3(std::cos(pitch) * std::sin(yaw), std::sin(pitch),
+                          std::cos(pitch) * std::cos(yaw));
+    frames.push_back(frame);
+  }
+  return (frames);
+}
+
+glm::ivec2 chunk_of(glm::vec3 pos) {
+  return (glm::ivec2((static_cast<int>(pos.x) >> 4) * CHUNK_SIZE,
+                     (static_cast<int>(pos.z) >> 4) * CHUNK_SIZE));
+}
+
+bool in_radius(glm::ivec2 chunk_pos, glm::ivec2 center, int radius) {
+  glm::ivec2 offset = (chunk_pos - center) / CHUNK_SIZE;
+  return (offset.x * offset.x + offset.y * offset.y <= radius * radius);
+}
+
+// Frames with a chunk missing in view, out of frames.size()
+size_t simulate(const std::vector<Frame>& frames, enum PrefetchPolicy policy,
+                float chunks_per_frame) {
+  const int radius = SIM_RENDER_DISTANCE;
+  std::vector<glm::ivec2> offsets;
+  for (int x = -radius; x <= radius; x++) {
+    for (int z = -radius; z <= radius; z++) {
+      if (x * x + z * z <= radius * radius) {
+        offsets.push_back(glm::ivec2(x, z) * CHUNK_SIZE);
+      }
+    }
+  }
+  glm::mat4 proj = glm::perspective(glm::radians(80.0f), 16.0f / 9.0f, 0.1f,
+                                    1000.0f);
+  FrustrumCulling frustrum;
+  ChunkQueue queue;
+  std::unordered_set<glm::ivec2, ivec2Comparator> ready;
+  // Spawn area already there, as after the loading screen
+  glm::ivec2 center = chunk_of(frames[0].pos);
+  for (const auto& offset : offsets) {
+    ready.insert(center + offset);
+  }
+  glm::vec3 velocity(0.0f);
+  float budget = 0.0f;
+  size_t missing_frames = 0;
+  for (size_t i = 0; i < frames.size(); i++) {
+    const Frame& frame = frames[i];
+    if (i > 0) {
+      // As ChunkManager::update
+      glm::vec3 speed = (frame.pos - frames[i - 1].pos) * SIM_FPS;
+      velocity += (speed - velocity) * 0.1f;
+    }
+    glm::ivec2 player_chunk = chunk_of(frame.pos);
+    if (player_chunk != center) {
+      center = player_chunk;
+      for (auto it = ready.begin(); it != ready.end();) {
+        if (!in_radius(*it, center, radius + CHUNK_UNLOAD_MARGIN)) {
+          it = ready.erase(it);
+        } else {
+          it++;
+        }
+      }
+      for (const auto& offset : offsets) {
+        if (ready.count(center + offset) == 0) {
+          queue.push(center + offset);
+        }
+      }
+    }
+    queue.setCenter(
+        prefetch_focus(policy, frame.pos, velocity, frame.dir, radius));
+    budget += chunks_per_frame;
+    glm::ivec2 pos;
+    while (budget >= 1.0f && queue.pop(pos)) {
+      if (in_radius(pos, center, radius + CHUNK_UNLOAD_MARGIN)) {
+        ready.insert(pos);
+        budget -= 1.0f;
+      }
+    }
+    budget = std::min(budget, 1.0f);
+    // Same test as ChunkManager::setRenderAttributes
+    glm::vec3 up(0.0f, 1.0f, 0.0f);
+    frustrum.updateViewPlanes(
+        proj * glm::lookAt(frame.pos, frame.pos + frame.dir, up));
+    glm::vec3 half(CHUNK_SIZE / 2, CHUNK_HEIGHT / 2, CHUNK_SIZE / 2);
+    for (const auto& offset : offsets) {
+      glm::ivec2 chunk_pos = center + offset;
+      if (ready.count(chunk_pos) == 0 &&
+          frustrum.cull(glm::vec3(chunk_pos.x, 0, chunk_pos.y) + half, half)) {
+        missing_frames++;
+        break;
+      }
+    }
+  }
+  return (missing_frames);
+}
+
+int main(int argc, char** argv) {
+  const char* filename = argc > 1 ? argv[1] : "test/flight_path.txt";
+  std::vector<Keyframe> keys;
+  if (read_path(filename, keys) == false) {
+    std::cerr << filename << ": cannot read flight path" << std::endl;
+    return (1);
+  }
+  std::vector<Frame> frames = replay_path(keys);
+  std::cout << frames.size() << " frames, render distance "
+            << SIM_RENDER_DISTANCE << std::endl;
+  const float capacities[] = {0.5f, 0.7f, 1.0f};
+  for (float capacity : capacities) {
+    size_t distance = simulate(frames, PrefetchPolicy::Distance, capacity);
+    size_t predictive =
+        simulate(frames, PrefetchPolicy::Predictive, capacity);
+    std::cout << capacity << " chunks/frame: frames missing a chunk in view, "
+              << "distance " << distance << ", predictive " << predictive
+              << std::endl;
+  }
+  return (0);
+}
@@ -0,0 +1,94 @@
+// ChunkQueue fuzz test against a reference set scanned for the nearest
+// position, as the getNearestIdx loop it replaced did. Covers push of
+// queued positions, erase (tombstones and rebuilds), re-centring, clear
+// and copies. Exits with 1 on the first mismatch.
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <set>
+#include <utility>
+#include "queue.hpp"
+
+#define FUZZ_OPERATIONS 200000
+
+typedef std::set<std::pair<int, int> > ReferenceQueue;
+
+int64_t distance_key(glm::ivec2 pos, glm::ivec2 center) {
+  int64_t dx = pos.x - center.x;
+  int64_t dz = pos.y - center.y;
+  return (dx * dx + dz * dz);
+}
+
+bool check_pop(ChunkQueue& queue, ReferenceQueue& reference,
+               glm::ivec2 center, int operation) {
+  glm::ivec2 pos;
+  bool popped = queue.pop(pos);
+  if (popped != (reference.empty() == false)) {
+    std::cerr << operation << ": pop returned " << popped << " with "
+              << reference.size() << " queued" << std::endl;
+    return (false);
+  }
+  if (popped == false) {
+    return (true);
+  }
+  int64_t nearest = INT64_MAX;
+  for (const auto& queued : reference) {
+    nearest = std::min(
+        nearest, distance_key(glm::ivec2(queued.first, queued.second), center));
+  }
+  // Equal distances may come out in any order
+  if (distance_key(pos, center) != nearest ||
+      reference.erase(std::make_pair(pos.x, pos.y)) == 0) {
+    std::cerr << operation << ": popped " << pos.x << " " << pos.y
+              << ", not the nearest queued position" << std::endl;
+    return (false);
+  }
+  return (true);
+}
+
+int main(void) {
+  std::mt19937 rng(3);
+  ChunkQueue queue;
+  ReferenceQueue reference;
+  glm::ivec2 center(0);
+  for (int i = 0; i < FUZZ_OPERATIONS; i++) {
+    glm::ivec2 pos((static_cast<int>(rng() % 64) - 32) * CHUNK_SIZE,
+                   (static_cast<int>(rng() % 64) - 32) * CHUNK_SIZE);
+    int operation = rng() % 100;
+    if (operation < 40) {
+      queue.push(pos);
+      reference.insert(std::make_pair(pos.x, pos.y));
+    } else if (operation < 60) {
+      queue.erase(pos);
+      reference.erase(std::make_pair(pos.x, pos.y));
+    } else if (operation < 68) {
+      center = glm::ivec2((static_cast<int>(rng() % 16) - 8) * CHUNK_SIZE,
+                          (static_cast<int>(rng() % 16) - 8) * CHUNK_SIZE);
+      queue.setCenter(center);
+    } else if (operation < 69) {
+      ChunkQueue copy(queue);
+      queue = copy;
+    } else if (operation == 69 && rng() % 20 == 0) {
+      queue.clear();
+      reference.clear();
+    } else if (check_pop(queue, reference, center, i) == false) {
+      return (1);
+    }
+    bool queued = reference.count(std::make_pair(pos.x, pos.y)) != 0;
+    if (queue.size() != reference.size() ||
+        queue.empty() != reference.empty() ||
+        queue.contains(pos) != queued) {
+      std::cerr << i << ": " << queue.size() << " queued, expected "
+                << reference.size() << std::endl;
+      return (1);
+    }
+  }
+  while (reference.empty() == false) {
+    if (check_pop(queue, reference, center, FUZZ_OPERATIONS) == false) {
+      return (1);
+    }
+  }
+  std::cout << FUZZ_OPERATIONS << " operations: same order as the reference"
+            << std::endl;
+  return (0);
+}
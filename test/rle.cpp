@@ -0,0 +1,147 @@
+// RLE fuzz test and microbenchmark: io::encodeRLE / io::decodeRLE against
+// the original scalar implementation, which defines the .vox byte format.
+// Exits with 1 on the first mismatch.
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <vector>
+#include "io.hpp"
+
+#define FUZZ_CASES 3000
+#define BENCH_CHUNKS 256
+#define BENCH_ROUNDS 20
+
+namespace legacy {
+// As shipped before vectorization. Reads data[CHUNK_BLOCKS], callers
+// provide that extra block, and drops the last pair.
+size_t encodeRLE(const Block* data, unsigned char* dest) {
+  size_t len_rle = 0;
+  for (size_t i = 0; i < CHUNK_BLOCKS; i++) {
+    unsigned char c = 1;
+    while (data[i] == data[i + 1] && c < 255) {
+      c++;
+      i++;
+    }
+    dest[len_rle] = c;
+    dest[len_rle + 1] = static_cast<unsigned char>(data[i].material);
+    len_rle += 2;
+  }
+  return (len_rle - 2);
+}
+
+void decodeRLE(const unsigned char* encoded_data, size_t rle_size,
+               Block* data, unsigned int limit) {
+  size_t data_offset = 0;
+  for (unsigned int i = 0; i < rle_size; i += 2) {
+    unsigned char len = encoded_data[i];
+    unsigned char value = encoded_data[i + 1];
+    for (int j = 0; j < len; j++) {
+      if (data_offset >= limit) return;
+      data[data_offset].material = static_cast<Material>(value);
+      data_offset++;
+    }
+  }
+}
+}  // namespace legacy
+
+// Runs of random length and material, lengths around the 255 split
+// boundary included. The block after the chunk differs from the last one
+// so the legacy encoder never extends a run past the end.
+void make_chunk(std::mt19937& rng, std::vector<Block>& data) {
+  static const int lengths[] = {1, 2, 254, 255, 256, 509, 510, 511, 4096};
+  int materials = 1 + rng() % 13;
+  size_t i = 0;
+  while (i < CHUNK_BLOCKS) {
+    size_t run = rng() % 2 ? lengths[rng() % 9] : 1 + rng() % 64;
+    enum Material material = static_cast<Material>(rng() % materials);
+    for (size_t end = std::min<size_t>(CHUNK_BLOCKS, i + run); i < end; i++) {
+      data[i] = Block(material);
+    }
+  }
+  unsigned char last =
+      static_cast<unsigned char>(data[CHUNK_BLOCKS - 1].material);
+  data[CHUNK_BLOCKS] = Block(static_cast<Material>(last ^ 1));
+}
+
+bool fuzz() {
+  std::mt19937 rng(42);
+  std::vector<Block> data(CHUNK_BLOCKS + 1);
+  std::vector<unsigned char> expected(CHUNK_BLOCKS * 2 + 2);
+  std::vector<unsigned char> encoded(CHUNK_BLOCKS * 2 + 2);
+  std::vector<Block> decoded(CHUNK_BLOCKS);
+  std::vector<Block> legacy_decoded(CHUNK_BLOCKS);
+  for (int i = 0; i < FUZZ_CASES; i++) {
+    make_chunk(rng, data);
+    if (i == 0) {
+      std::fill(data.begin(), data.end() - 1, Block(Material::Stone));
+    }
+    size_t expected_size = legacy::encodeRLE(data.data(), expected.data());
+    size_t size = io::encodeRLE(data.data(), encoded.data());
+    if (size != expected_size ||
+        std::memcmp(encoded.data(), expected.data(), size) != 0) {
+      std::cerr << "case " << i << ": encoded bytes differ" << std::endl;
+      return (false);
+    }
+    // Truncated streams too, the dropped last pair leaves the tail as is
+    size_t stream = i % 4 == 0 ? size / 3 / 2 * 2 : size;
+    std::fill(decoded.begin(), decoded.end(), Block(Material::Leaf));
+    std::fill(legacy_decoded.begin(), legacy_decoded.end(),
+              Block(Material::Leaf));
+    io::decodeRLE(encoded.data(), stream, decoded.data(), CHUNK_BLOCKS);
+    legacy::decodeRLE(expected.data(), stream, legacy_decoded.data(),
+                      CHUNK_BLOCKS);
+    if (decoded != legacy_decoded) {
+      std::cerr << "case " << i << ": decoded blocks differ" << std::endl;
+      return (false);
+    }
+    if (stream == size && decoded[CHUNK_BLOCKS - 1] != Block(Material::Leaf)) {
+      std::cerr << "case " << i << ": last pair was written" << std::endl;
+      return (false);
+    }
+  }
+  return (true);
+}
+
+template <class Encode, class Decode>
+void bench(const char* name, const std::vector<std::vector<Block> >& chunks,
+           Encode encode, Decode decode) {
+  std::vector<unsigned char> encoded(CHUNK_BLOCKS * 2 + 2);
+  std::vector<Block> decoded(CHUNK_BLOCKS);
+  double encode_time = 0.0;
+  double decode_time = 0.0;
+  size_t checksum = 0;
+  for (int round = 0; round < BENCH_ROUNDS; round++) {
+    for (const auto& chunk : chunks) {
+      auto start = std::chrono::steady_clock::now();
+      size_t size = encode(chunk.data(), encoded.data());
+      auto middle = std::chrono::steady_clock::now();
+      decode(encoded.data(), size, decoded.data(), CHUNK_BLOCKS);
+      auto end = std::chrono::steady_clock::now();
+      encode_time += std::chrono::duration<double>(middle - start).count();
+      decode_time += std::chrono::duration<double>(end - middle).count();
+      checksum += size + static_cast<size_t>(decoded[0].material);
+    }
+  }
+  double mb = chunks.size() * BENCH_ROUNDS * CHUNK_BLOCKS / (1024.0 * 1024.0);
+  std::cout << name << ": encode " << static_cast<int>(mb / encode_time)
+            << " MB/s, decode " << static_cast<int>(mb / decode_time)
+            << " MB/s (" << checksum << ")" << std::endl;
+}
+
+int main(void) {
+  if (fuzz() == false) {
+    return (1);
+  }
+  std::cout << FUZZ_CASES << " chunks: same bytes as the legacy encoder"
+            << std::endl;
+  std::mt19937 rng(7);
+  std::vector<std::vector<Block> > chunks(
+      BENCH_CHUNKS, std::vector<Block>(CHUNK_BLOCKS + 1));
+  for (auto& chunk : chunks) {
+    make_chunk(rng, chunk);
+  }
+  bench("legacy", chunks, legacy::encodeRLE, legacy::decodeRLE);
+  bench("io", chunks, io::encodeRLE, io::decodeRLE);
+  return (0);
+}
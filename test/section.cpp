@@ -0,0 +1,221 @@
+// ChunkSections test and benchmark. Round trips through set, get, copyTo
+// and unpack at every index width (0, 1, 2 and 4 bits), palettes widened
+// by set() and shrunk by assign(). Then memory per chunk and mesher
+// throughput against flat block arrays on generated terrain.
+// Exits with 1 on the first mismatch.
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <vector>
+#include "generator.hpp"
+#include "meshing.hpp"
+#include "section.hpp"
+
+#define BENCH_SEED 42
+#define BENCH_WORLD 8  // Chunks per side
+#define BENCH_ROUNDS 3
+#define TEST_SETS 20000
+
+typedef std::chrono::steady_clock bench_clock;
+
+double elapsed_us(bench_clock::time_point start) {
+  return (std::chrono::duration<double, std::micro>(bench_clock::now() -
+                                                    start)
+              .count());
+}
+
+// Index width a palette of that size needs
+int bits_for(int palette_size) {
+  if (palette_size <= 1) {
+    return (0);
+  }
+  return (palette_size <= 2 ? 1 : palette_size <= 4 ? 2 : 4);
+}
+
+// Every accessor of sections against the flat reference
+bool matches(const ChunkSections& sections, const std::vector<Block>& flat,
+             const char* step) {
+  std::vector<Block> copy(CHUNK_BLOCKS);
+  sections.copyTo(copy.data());
+  if (copy != flat) {
+    std::cerr << step << ": copyTo differs" << std::endl;
+    return (false);
+  }
+  std::vector<Block> section(SECTION_BLOCKS);
+  for (int id = 0; id < MODEL_PER_CHUNK; id++) {
+    sections.unpack(id, section.data());
+    int count = 0;
+    for (int i = 0; i < SECTION_BLOCKS; i++) {
+      Block block = flat[id * SECTION_BLOCKS + i];
+      count += block.material != Material::Air ? 1 : 0;
+      if (section[i] != block ||
+          sections.get(id * SECTION_BLOCKS + i) != block) {
+        std::cerr << step << ": section " << id << " block " << i
+                  << " differs" << std::endl;
+        return (false);
+      }
+    }
+    if (sections.getBlockCount(id) != count) {
+      std::cerr << step << ": section " << id << " count differs"
+                << std::endl;
+      return (false);
+    }
+  }
+  for (int x = 0; x < CHUNK_SIZE; x++) {
+    for (int z = 0; z < CHUNK_SIZE; z++) {
+      int height = CHUNK_HEIGHT - 1;
+      while (height >= 0 &&
+             flat[BlockLayout::index(x, height, z)].material == Material::Air) {
+        height--;
+      }
+      if (sections.getHeight(x, z) != height) {
+        std::cerr << step << ": column " << x << " " << z
+                  << " height differs" << std::endl;
+        return (false);
+      }
+    }
+  }
+  return (true);
+}
+
+// Section i holds i % 14 materials (0: all air): every width is covered
+bool check_assign() {
+  std::mt19937 rng(1);
+  std::vector<Block> flat(CHUNK_BLOCKS);
+  for (int id = 0; id < MODEL_PER_CHUNK; id++) {
+    int materials = id % 14;
+    for (int i = 0; i < SECTION_BLOCKS; i++) {
+      int material = materials == 0 ? 0 : i < materials ? i : rng() % materials;
+      flat[id * SECTION_BLOCKS + i] = Block(static_cast<Material>(material));
+    }
+  }
+  ChunkSections sections;
+  sections.assign(flat.data());
+  for (int id = 0; id < MODEL_PER_CHUNK; id++) {
+    SectionView view = sections.getSection(id);
+    int expected = id % 14 == 0 ? 1 : id % 14;
+    if (view.palette_size != expected ||
+        view.uniform != (bits_for(expected) == 0)) {
+      std::cerr << "assign: section " << id << " palette of "
+                << view.palette_size << ", expected " << expected
+                << std::endl;
+      return (false);
+    }
+  }
+  return (matches(sections, flat, "assign"));
+}
+
+// Materials brought in one at a time by set(), widening 0 -> 1 -> 2 -> 4
+// bits, then assign() rebuilding smaller palettes
+bool check_set() {
+  std::mt19937 rng(2);
+  std::vector<Block> flat(CHUNK_BLOCKS);
+  ChunkSections sections;
+  sections.assign(flat.data());
+  for (int i = 0; i < TEST_SETS; i++) {
+    // Small areas so sections go through every width
+    int id = rng() % 4;
+    int limit = 1 + i * 13 / TEST_SETS;
+    int index = id * SECTION_BLOCKS + rng() % SECTION_BLOCKS;
+    Block block(static_cast<Material>(rng() % (limit + 1)));
+    sections.set(index, block);
+    flat[index] = block;
+    if (sections.get(index) != block) {
+      std::cerr << "set: block " << index << " reads back wrong" << std::endl;
+      return (false);
+    }
+    if (i % 1000 == 0 && matches(sections, flat, "set") == false) {
+      return (false);
+    }
+  }
+  if (matches(sections, flat, "set") == false) {
+    return (false);
+  }
+  size_t widened = sections.getMemoryUsage();
+  // Back to two materials: assign() shrinks the palettes and indices
+  for (int i = 0; i < 4 * SECTION_BLOCKS; i++) {
+    flat[i] = Block(i % 3 == 0 ? Material::Stone : Material::Air);
+  }
+  sections.assign(flat.data());
+  if (sections.getSection(0).palette_size != 2 ||
+      sections.getMemoryUsage() >= widened) {
+    std::cerr << "assign: palettes not shrunk" << std::endl;
+    return (false);
+  }
+  // Removing the top of columns, heights go down through empty sections
+  for (int i = 0; i < 4 * SECTION_BLOCKS; i++) {
+    sections.set(i, Block());
+    flat[i] = Block();
+  }
+  return (matches(sections, flat, "shrink"));
+}
+
+void bench() {
+  generator::init(10000, BENCH_SEED);
+  std::vector<std::vector<Block> > chunks;
+  std::vector<Biome> biome(CHUNK_SIZE * CHUNK_SIZE);
+  for (int x = 0; x < BENCH_WORLD; x++) {
+    for (int z = 0; z < BENCH_WORLD; z++) {
+      chunks.push_back(std::vector<Block>(CHUNK_BLOCKS));
+      generator::generate_chunk(
+          chunks.back().data(), biome.data(),
+          glm::vec3(x * CHUNK_SIZE, 0, z * CHUNK_SIZE));
+    }
+  }
+  std::vector<ChunkSections> sections(chunks.size());
+  size_t bytes = 0;
+  for (size_t i = 0; i < chunks.size(); i++) {
+    sections[i].assign(chunks[i].data());
+    bytes += sections[i].getMemoryUsage();
+  }
+  double gb = 1024.0 * 1024.0 * 1024.0;
+  size_t flat_bytes = CHUNK_BLOCKS * sizeof(Block);
+  std::cout << chunks.size() << " chunks, seed " << BENCH_SEED << std::endl;
+  std::cout << "flat: " << flat_bytes << " B/chunk, "
+            << static_cast<int>(gb / flat_bytes) << " chunks/GB" << std::endl;
+  std::cout << "sections: " << bytes / chunks.size() << " B/chunk, "
+            << static_cast<int>(gb * chunks.size() / bytes) << " chunks/GB"
+            << std::endl;
+
+  // Mesh jobs run the mesher on a flat copy of the sections
+  bool dirty[MODEL_PER_CHUNK];
+  std::fill(dirty, dirty + MODEL_PER_CHUNK, true);
+  std::vector<Vertex> vertices[MODEL_PER_CHUNK];
+  std::vector<Block> copy(CHUNK_BLOCKS);
+  double flat_us = 0.0;
+  double sections_us = 0.0;
+  double copy_us = 0.0;
+  for (int round = 0; round < BENCH_ROUNDS; round++) {
+    for (size_t i = 0; i < chunks.size(); i++) {
+      auto start = bench_clock::now();
+      mesher::greedy(chunks[i].data(), dirty, vertices);
+      flat_us += elapsed_us(start);
+      for (auto& section : vertices) {
+        section.clear();
+      }
+      start = bench_clock::now();
+      sections[i].copyTo(copy.data());
+      copy_us += elapsed_us(start);
+      mesher::greedy(copy.data(), dirty, vertices);
+      sections_us += elapsed_us(start);
+      for (auto& section : vertices) {
+        section.clear();
+      }
+    }
+  }
+  double meshes = BENCH_ROUNDS * chunks.size();
+  std::cout << "mesher on flat arrays: " << static_cast<int>(flat_us / meshes)
+            << " us/chunk" << std::endl;
+  std::cout << "mesher on sections: "
+            << static_cast<int>(sections_us / meshes) << " us/chunk (copyTo "
+            << static_cast<int>(copy_us / meshes) << ")" << std::endl;
+}
+
+int main(void) {
+  if (check_assign() == false || check_set() == false) {
+    return (1);
+  }
+  std::cout << "sections round trip at every index width" << std::endl;
+  bench();
+  return (0);
+}
@@ -0,0 +1,142 @@
+// ChunkStore fuzz test against a reference map. A resident area follows a
+// random walk, so the ring is re-centred over and over, while chunks far
+// away land in slots already taken and go through the fallback map.
+// Every step checks lookups, the chunk list and the neighbour links of
+// every resident chunk. Exits with 1 on the first mismatch.
+#include <iostream>
+#include <map>
+#include <random>
+#include <set>
+#include <utility>
+#include "chunk.hpp"
+#include "store.hpp"
+
+#define STORE_RADIUS 4  // Ring of 16x16 slots
+#define FUZZ_STEPS 3000
+
+typedef std::map<std::pair<int, int>, Chunk*> ReferenceStore;
+
+Chunk* reference_find(const ReferenceStore& reference, glm::ivec2 pos) {
+  auto it = reference.find(std::make_pair(pos.x, pos.y));
+  return (it != reference.end() ? it->second : nullptr);
+}
+
+bool check(ChunkStore& store, const ReferenceStore& reference,
+           glm::ivec2 center, int step) {
+  if (store.size() != reference.size() ||
+      store.chunks().size() != reference.size()) {
+    std::cerr << step << ": " << store.size() << " chunks, expected "
+              << reference.size() << std::endl;
+    return (false);
+  }
+  std::set<Chunk*> listed(store.chunks().begin(), store.chunks().end());
+  for (const auto& entry : reference) {
+    glm::ivec2 pos(entry.first.first, entry.first.second);
+    Chunk* chunk = entry.second;
+    if (store.find(pos) != chunk || listed.count(chunk) == 0 ||
+        chunk->get_pos() != glm::ivec3(pos.x, 0, pos.y)) {
+      std::cerr << step << ": chunk " << pos.x << " " << pos.y
+                << " not found" << std::endl;
+      return (false);
+    }
+    for (int dx = -1; dx <= 1; dx++) {
+      for (int dz = -1; dz <= 1; dz++) {
+        glm::ivec2 neighbour = pos + glm::ivec2(dx, dz) * CHUNK_SIZE;
+        if (chunk->getNeighbour(dx, dz) !=
+            reference_find(reference, neighbour)) {
+          std::cerr << step << ": chunk " << pos.x << " " << pos.y
+                    << " has a stale link to " << dx << " " << dz
+                    << std::endl;
+          return (false);
+        }
+      }
+    }
+  }
+  // Absent positions, around the area and where it wraps on the ring
+  int wrap = 16 * CHUNK_SIZE;
+  for (int x = -8; x <= 8; x++) {
+    for (int z = -8; z <= 8; z++) {
+      glm::ivec2 pos = center + glm::ivec2(x, z) * CHUNK_SIZE;
+      glm::ivec2 wrapped = pos + glm::ivec2(wrap, -wrap);
+      if (store.find(pos) != reference_find(reference, pos) ||
+          store.find(wrapped) != reference_find(reference, wrapped)) {
+        std::cerr << step << ": lookup of " << pos.x << " " << pos.y
+                  << " differs" << std::endl;
+        return (false);
+      }
+    }
+  }
+  return (true);
+}
+
+int main(void) {
+  std::mt19937 rng(5);
+  ChunkStore store(STORE_RADIUS);
+  ReferenceStore reference;
+  glm::ivec2 center(0);
+  size_t max_fallback = 0;
+  for (int step = 0; step < FUZZ_STEPS; step++) {
+    center += glm::ivec2(static_cast<int>(rng() % 3) - 1,
+                         static_cast<int>(rng() % 3) - 1) *
+              CHUNK_SIZE;
+    // Area first, chunks left behind are erased like unloaded ones
+    for (auto it = reference.begin(); it != reference.end();) {
+      glm::ivec2 offset =
+          (glm::ivec2(it->first.first, it->first.second) - center) /
+          CHUNK_SIZE;
+      bool far = std::abs(offset.x) > 16 || std::abs(offset.y) > 16;
+      if (far == false && offset.x * offset.x + offset.y * offset.y >
+                              STORE_RADIUS * STORE_RADIUS &&
+          rng() % 4 != 0) {
+        store.erase(glm::ivec2(it->first.first, it->first.second));
+        it = reference.erase(it);
+      } else {
+        it++;
+      }
+    }
+    for (int x = -STORE_RADIUS; x <= STORE_RADIUS; x++) {
+      for (int z = -STORE_RADIUS; z <= STORE_RADIUS; z++) {
+        if (x * x + z * z > STORE_RADIUS * STORE_RADIUS || rng() % 3 == 0) {
+          continue;
+        }
+        glm::ivec2 pos = center + glm::ivec2(x, z) * CHUNK_SIZE;
+        bool inserted;
+        Chunk* chunk = store.insert(pos, inserted);
+        auto key = std::make_pair(pos.x, pos.y);
+        if (inserted != (reference.count(key) == 0) ||
+            (!inserted && reference[key] != chunk)) {
+          std::cerr << step << ": insert of " << pos.x << " " << pos.y
+                    << " differs" << std::endl;
+          return (1);
+        }
+        reference[key] = chunk;
+      }
+    }
+    // A chunk loaded far away, or one of those going away
+    glm::ivec2 far = center + glm::ivec2(static_cast<int>(rng() % 5) + 20,
+                                         static_cast<int>(rng() % 5) - 2) *
+                                  CHUNK_SIZE;
+    bool inserted;
+    if (rng() % 2 == 0) {
+      reference[std::make_pair(far.x, far.y)] = store.insert(far, inserted);
+    } else {
+      store.erase(far);
+      reference.erase(std::make_pair(far.x, far.y));
+    }
+    max_fallback = std::max(max_fallback, store.getFallbackCount());
+    if (check(store, reference, center, step) == false) {
+      return (1);
+    }
+    if (step % 1000 == 999) {
+      store.clear();
+      reference.clear();
+    }
+  }
+  if (max_fallback == 0) {
+    std::cerr << "the fallback map was never used" << std::endl;
+    return (1);
+  }
+  std::cout << FUZZ_STEPS << " steps, up to " << max_fallback
+            << " fallback chunks: same as the reference" << std::endl;
+  return (0);
+}